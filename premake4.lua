@@ -17,6 +17,20 @@ newaction {
 }
 
 
+-- Loader code of the models sample that the lighting samples build in too:
+-- image decoding, CPU mip chains, channel-aware uploads and program binaries.
+local sharedLoaders = {
+    "src/models/common.cpp",
+    "src/models/compress.cpp",
+    "src/models/error.cpp",
+    "src/models/mipmap.cpp",
+    "src/models/pool.cpp",
+    "src/models/progcache.cpp",
+    "src/models/state.cpp",
+    "src/models/texture.cpp"
+}
+
+
 solution "glcookbook"
     configurations {"Debug", "Release"}
         language "C++"
@@ -141,38 +155,51 @@ solution "glcookbook"
 
     project "color"
         location "build/color"
+        includedirs {"src/models"}
         files {
             "src/color/**.cpp",
             "src/color/**.hpp"
         }
+        files(sharedLoaders)
 
     project "basic_lighting"
         location "build/basic_lighting"
+        includedirs {"src/models"}
         files {
             "src/basic_lighting/**.cpp",
             "src/basic_lighting/**.hpp"
         }
+        files(sharedLoaders)
 
     project "material"
         location "build/material"
+        includedirs {"src/models"}
         files {
             "src/material/**.cpp",
             "src/material/**.hpp"
         }
+        files(sharedLoaders)
 
     project "lightmaps"
         location "build/lightmaps"
+        includedirs {"src/models"}
         files {
             "src/lightmaps/**.cpp",
             "src/lightmaps/**.hpp"
         }
+        files(sharedLoaders)
 
     project "lightcasters"
         location "build/lightcasters"
+        -- Also shares the uniform block mirrors and the shader
+        -- preprocessor with the models sample.
+        includedirs {"src/models"}
         files {
             "src/lightcasters/**.cpp",
-            "src/lightcasters/**.hpp"
+            "src/lightcasters/**.hpp",
+            "src/models/preprocess.cpp"
         }
+        files(sharedLoaders)
 
     project "models"
         location "build/models"
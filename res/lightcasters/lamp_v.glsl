@@ -3,8 +3,8 @@
 layout (location = 0) in vec3 position;
 
 uniform mat4 Model;
-uniform mat4 View;
-uniform mat4 Projection;
+
+#include "../models/frame.glsl"
 
 void main()
 {
@@ -4,10 +4,11 @@ layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texture;
 
-uniform mat3 Normal;
-uniform mat4 Model;
-uniform mat4 View;
-uniform mat4 Projection;
+// Per instance: the cube's transform.
+layout (location = 3) in mat4 Model;
+layout (location = 7) in mat3 Normal;
+
+#include "../models/frame.glsl"
 
 out vec3 vertexPosition;
 out vec3 vertexNormal;
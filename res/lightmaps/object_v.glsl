@@ -4,8 +4,10 @@ layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texture;
 
-uniform mat3 Normal;
-uniform mat4 Model;
+// Per instance: the cube's transform.
+layout (location = 3) in mat4 Model;
+layout (location = 7) in mat3 Normal;
+
 uniform mat4 View;
 uniform mat4 Projection;
 
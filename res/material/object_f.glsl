@@ -2,6 +2,9 @@
 
 in vec3 vertexPosition;
 in vec3 vertexNormal;
+flat in int vertexMaterial;
+
+#define MAX_MATERIALS 16
 
 struct material {
     vec3 ka;
@@ -18,7 +21,10 @@ struct light {
 };
 
 uniform light Light;
-uniform material Material;
+layout (std140) uniform Materials
+{
+    material Palette[MAX_MATERIALS];
+};
 uniform vec3 CameraPosition;
 
 out vec4 finalColor;
@@ -30,6 +36,8 @@ void main()
     vec3 rd = reflect(-ld, vertexNormal);
     vec3 n  = normalize(vertexNormal);
 
+    material Material = Palette[vertexMaterial];
+
     vec3 ka = Light.ka * Material.ka;
     vec3 kd = Light.kd * Material.kd * max(dot(n, ld), 0.0f);
     vec3 ks = Light.ks * Material.ks * pow(max(dot(v, rd), 0.0), Material.a);
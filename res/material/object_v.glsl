@@ -3,18 +3,23 @@
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 
-uniform mat3 Normal;
-uniform mat4 Model;
+// Per instance: the cube's transform and its entry in the palette.
+layout (location = 2) in mat4 Model;
+layout (location = 6) in mat3 Normal;
+layout (location = 9) in int MaterialIndex;
+
 uniform mat4 View;
 uniform mat4 Projection;
 
 out vec3 vertexPosition;
 out vec3 vertexNormal;
+flat out int vertexMaterial;
 
 void main()
 {
     vertexNormal   = Normal * normal;
     vertexPosition = vec3(Model * vec4(position, 1.0f));
+    vertexMaterial = MaterialIndex;
 
     gl_Position = Projection * View * Model * vec4(position, 1.0f);
-}
\ No newline at end of file
+}
@@ -0,0 +1,16 @@
+#version 330 core
+
+in vec3 vertexPosition;
+in vec3 vertexNormal;
+in vec2 vertexTexture;
+
+out vec4 finalColor;
+
+// Plain grey with a fixed light, drawn while the real shaders still build.
+void main()
+{
+    vec3 lightDir = normalize(vec3(0.2f, 1.0f, 0.3f));
+    float diffuse = max(dot(normalize(vertexNormal), lightDir), 0.0f);
+
+    finalColor = vec4(vec3(0.2f + 0.6f * diffuse), 1.0f);
+}
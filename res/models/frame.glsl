@@ -0,0 +1,7 @@
+// Per-frame camera data; glc::FrameBlock mirrors it.
+layout (std140) uniform Frame
+{
+    mat4 View;
+    mat4 Projection;
+    vec3 CameraPosition;
+};
@@ -0,0 +1,106 @@
+// Keep in step with glc::MAX_POINT_LIGHTS.
+#define MAX_POINT_LIGHTS 4
+
+#ifndef NUM_POINT_LIGHTS
+#define NUM_POINT_LIGHTS 0
+#endif
+
+// The light structs are laid out for std140, with each float filling the
+// padding after a vec3; glc::LightsBlock mirrors them.
+struct slight {
+    vec3 position;
+    float cutOffAngle;
+    vec3 spotDir;
+    float cutInAngle;
+    vec3 ka;
+    vec3 kd;
+    vec3 ks;
+};
+
+struct dlight {
+    vec3 direction;
+    vec3 ka;
+    vec3 kd;
+    vec3 ks;
+};
+
+struct plight {
+    vec3 position;
+    float kc;
+    vec3 ka;
+    float kl;
+    vec3 kd;
+    float kq;
+    vec3 ks;
+};
+
+// Always declared in full, so every variant shares one buffer layout.
+layout (std140) uniform Lights
+{
+    slight SLight;
+    plight PLights[MAX_POINT_LIGHTS];
+    dlight DLight;
+};
+
+// The material maps are sampled once by the caller. Without
+// HAS_SPECULAR_MAP the specular terms are left out entirely.
+vec3 getDirLight(dlight light, vec3 normal, vec3 viewDir,
+                 vec3 diffuseMap, vec3 specularMap, float shininess)
+{
+    vec3 lightDir = normalize(-light.direction);
+
+    float color = max(dot(normal, lightDir), 0.0f);
+
+    vec3 ka = light.ka * diffuseMap;
+    vec3 kd = light.kd * diffuseMap * color;
+#ifdef HAS_SPECULAR_MAP
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float intensity = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    kd += light.ks * specularMap * intensity;
+#endif
+
+    return (ka + kd);
+}
+
+vec3 getPointLight(plight light, vec3 normal, vec3 viewDir, vec3 fragPos,
+                   vec3 diffuseMap, vec3 specularMap, float shininess)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+
+    float color = max(dot(normal, lightDir), 0.0f);
+
+    float dist = length(light.position - fragPos);
+    float atten = 1.0f / (light.kc + light.kl * dist + light.kq * (dist * dist));
+
+    vec3 ka = light.ka * diffuseMap;
+    vec3 kd = light.kd * diffuseMap * color;
+#ifdef HAS_SPECULAR_MAP
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float intensity = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    kd += light.ks * specularMap * intensity;
+#endif
+
+    return (ka + kd) * atten;
+}
+
+vec3 getSpotLight(slight light, vec3 normal, vec3 viewDir, vec3 fragPos,
+                  vec3 diffuseMap, vec3 specularMap, float shininess)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+
+    float theta = dot(lightDir, normalize(-light.spotDir));
+    float epsilon = light.cutInAngle - light.cutOffAngle;
+    float fadeRate = clamp((theta - light.cutOffAngle) / epsilon, 0.0f, 1.0f);
+
+    float color = max(dot(normal, lightDir), 0.0f);
+
+    vec3 ka = light.ka * diffuseMap;
+    vec3 kd = light.kd * diffuseMap * color;
+#ifdef HAS_SPECULAR_MAP
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float intensity = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    kd += light.ks * specularMap * intensity;
+#endif
+
+    return ka + kd * fadeRate;
+}
@@ -1,125 +1,89 @@
 #version 330 core
 
+// Variants: HAS_DIR, HAS_SPOT and HAS_SPECULAR_MAP switch those features
+// on; NUM_POINT_LIGHTS (0 to MAX_POINT_LIGHTS) sets how many point lights
+// are evaluated; MULTI_DRAW takes the array layers from the vertex shader.
+
+#include "frame.glsl"
+#include "lights.glsl"
+
 in vec3 vertexPosition;
 in vec3 vertexNormal;
 in vec2 vertexTexture;
 
+#ifdef MULTI_DRAW
+flat in ivec2 vertexLayers;
+#define DIFFUSE_LAYER vertexLayers.x
+#define SPECULAR_LAYER vertexLayers.y
+#else
+#define DIFFUSE_LAYER Material.diffuseLayer
+#define SPECULAR_LAYER Material.specularLayer
+#endif
+
 struct material {
     sampler2D texture_diffuse1;
     sampler2D texture_specular1;
+    sampler2DArray diffuseArray;
+    sampler2DArray specularArray;
+    int diffuseLayer;
+    int specularLayer;
     float a;
 };
 
-struct slight {
-    vec3 position;
-    vec3 spotDir;
-    vec3 ka;
-    vec3 kd;
-    vec3 ks;
-    float cutOffAngle;
-    float cutInAngle;
-};
-
-struct dlight {
-    vec3 direction;
-    vec3 ka;
-    vec3 kd;
-    vec3 ks;
-};
-
-struct plight {
-    vec3 position;
-    vec3 ka;
-    vec3 kd;
-    vec3 ks;
-
-    float kc;
-    float kl;
-    float kq;
-};
-
-vec3 getDirLight(dlight light, vec3 normal, vec3 viewDir);
-vec3 getPointLight(plight light, vec3 normal, vec3 viewDir, vec3 fragPos);
-vec3 getSpotLight(slight light, vec3 normal, vec3 viewDir, vec3 fragPos);
-
-uniform slight SLight;
-uniform plight PLight;
-uniform dlight DLight;
 uniform material Material;
-uniform vec3 CameraPosition;
+
+// Textures come from layers of the material's arrays instead of the 2D
+// samplers.
+uniform bool TextureArrays;
 
 out vec4 finalColor;
 
+vec3 getDiffuseMap();
+vec3 getSpecularMap();
+
 void main()
 {
     vec3 viewDir = normalize(CameraPosition - vertexPosition);
     vec3 normal  = normalize(vertexNormal);
 
+    vec3 diffuseMap = getDiffuseMap();
+#ifdef HAS_SPECULAR_MAP
+    vec3 specularMap = getSpecularMap();
+#else
+    vec3 specularMap = vec3(0.0f);
+#endif
+
     vec3 res = vec3(0.0f);
-    res += getDirLight(DLight, normal, viewDir);
-    res += getPointLight(PLight, normal, viewDir, vertexPosition);
-    res += getSpotLight(SLight, normal, viewDir, vertexPosition);
+#ifdef HAS_DIR
+    res += getDirLight(DLight, normal, viewDir, diffuseMap, specularMap, Material.a);
+#endif
+    for (int i = 0; i < NUM_POINT_LIGHTS; i++)
+    {
+        res += getPointLight(PLights[i], normal, viewDir, vertexPosition,
+                             diffuseMap, specularMap, Material.a);
+    }
+#ifdef HAS_SPOT
+    res += getSpotLight(SLight, normal, viewDir, vertexPosition,
+                        diffuseMap, specularMap, Material.a);
+#endif
 
     finalColor = vec4(res, 1.0f);
 }
 
-vec3 getDirLight(dlight light, vec3 normal, vec3 viewDir)
+vec3 getDiffuseMap()
 {
-    vec3 lightDir = normalize(-light.direction);
-    vec3 reflectDir = reflect(-lightDir, normal);
-
-    vec3 diffuseMap = vec3(texture(Material.texture_diffuse1, vertexTexture));
-    vec3 specularMap = vec3(texture(Material.texture_specular1, vertexTexture));
-
-    float color = max(dot(normal, lightDir), 0.0f);
-    float intensity = pow(max(dot(viewDir, reflectDir), 0.0), Material.a);
-
-    vec3 ka = light.ka * diffuseMap;
-    vec3 kd = light.kd * diffuseMap * color;
-    vec3 ks = light.ks * specularMap * intensity;
-
-    return (ka + kd + ks);
+    if (TextureArrays)
+    {
+        return vec3(texture(Material.diffuseArray, vec3(vertexTexture, DIFFUSE_LAYER)));
+    }
+    return vec3(texture(Material.texture_diffuse1, vertexTexture));
 }
 
-vec3 getPointLight(plight light, vec3 normal, vec3 viewDir, vec3 fragPos)
+vec3 getSpecularMap()
 {
-    vec3 lightDir = normalize(light.position - fragPos);
-    vec3 reflectDir = reflect(-lightDir, normal);
-
-    vec3 diffuseMap = vec3(texture(Material.texture_diffuse1, vertexTexture));
-    vec3 specularMap = vec3(texture(Material.texture_specular1, vertexTexture));
-
-    float color = max(dot(normal, lightDir), 0.0f);
-    float intensity = pow(max(dot(viewDir, reflectDir), 0.0), Material.a);
-
-    float dist = length(light.position - fragPos);
-    float atten = 1.0f / (PLight.kc + PLight.kl * dist + PLight.kq * (dist * dist));
-
-    vec3 ka = light.ka * diffuseMap * atten;
-    vec3 kd = light.kd * diffuseMap * color * atten;
-    vec3 ks = light.ks * specularMap * intensity * atten;
-
-    return (ka + kd + ks);
+    if (TextureArrays)
+    {
+        return vec3(texture(Material.specularArray, vec3(vertexTexture, SPECULAR_LAYER)));
+    }
+    return vec3(texture(Material.texture_specular1, vertexTexture));
 }
-
-vec3 getSpotLight(slight light, vec3 normal, vec3 viewDir, vec3 fragPos)
-{
-    vec3 lightDir = normalize(light.position - fragPos);
-    vec3 reflectDir = reflect(-lightDir, normal);
-
-    float theta = dot(lightDir, normalize(-light.spotDir));
-    float epsilon = light.cutInAngle - light.cutOffAngle;
-    float fadeRate = clamp((theta - light.cutOffAngle) / epsilon, 0.0f, 1.0f);
-
-    vec3 diffuseMap = vec3(texture(Material.texture_diffuse1, vertexTexture));
-    vec3 specularMap = vec3(texture(Material.texture_specular1, vertexTexture));
-
-    float color = max(dot(normal, lightDir), 0.0f);
-    float intensity = pow(max(dot(viewDir, reflectDir), 0.0), Material.a);
-
-    vec3 ka = light.ka * diffuseMap;
-    vec3 kd = light.kd * diffuseMap * color * fadeRate;
-    vec3 ks = light.ks * specularMap * intensity * fadeRate;
-
-    return (ka + kd + ks);
-}
\ No newline at end of file
@@ -1,23 +1,106 @@
 #version 330 core
 
+// Variants: INSTANCED reads a per-instance transform; MULTI_DRAW is drawn
+// by glMultiDrawElementsIndirect and takes each draw's node transform,
+// dequantization and texture layers from the Draws buffer, indexed by
+// gl_BaseInstanceARB with HAS_DRAW_PARAMETERS and by DrawIndex otherwise.
+#ifdef MULTI_DRAW
+#extension GL_ARB_shader_storage_buffer_object : require
+#ifdef HAS_DRAW_PARAMETERS
+#extension GL_ARB_shader_draw_parameters : require
+#endif
+#endif
+
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texture;
 
+#ifdef INSTANCED
+// Per-instance transform, applied on top of the node's Model/Normal.
+layout (location = 3) in mat4 InstanceModel;
+layout (location = 7) in mat3 InstanceNormal;
+#endif
+
+#ifdef MULTI_DRAW
+struct draw {
+    mat4 world;
+    mat4 normal;
+    vec4 offset;
+    vec4 scale;
+    ivec4 layers;
+};
+
+layout (std430) buffer Draws
+{
+    draw Draw[];
+};
+
+// Each command's baseInstance holds its index across the whole batch;
+// gl_DrawIDARB would restart at 0 for every multi-draw call.
+#ifdef HAS_DRAW_PARAMETERS
+#define DRAW_INDEX gl_BaseInstanceARB
+#else
+// Fed through each command's baseInstance.
+layout (location = 10) in int DrawIndex;
+#define DRAW_INDEX DrawIndex
+#endif
+
+flat out ivec2 vertexLayers;
+#endif
+
+#include "frame.glsl"
+
 uniform mat3 Normal;
 uniform mat4 Model;
-uniform mat4 View;
-uniform mat4 Projection;
+
+// Packed vertex formats: positions are stored relative to the mesh bounds
+// and normals octahedral encoded in the first two components.
+#ifndef MULTI_DRAW
+uniform vec3 VertexOffset;
+uniform vec3 VertexScale;
+#endif
+uniform bool PackedNormals;
 
 out vec3 vertexPosition;
 out vec3 vertexNormal;
 out vec2 vertexTexture;
 
+vec3 decodeNormal(vec2 e)
+{
+    vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+    if (n.z < 0.0f)
+    {
+        vec2 s = vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+        n.xy = (1.0f - abs(n.yx)) * s;
+    }
+    return normalize(n);
+}
+
 void main()
 {
-    vertexNormal   = Normal * normal;
-    vertexPosition = vec3(Model * vec4(position, 1.0f));
+#if defined(MULTI_DRAW)
+    draw d = Draw[DRAW_INDEX];
+    vec3 localPosition = d.offset.xyz + d.scale.xyz * position;
+    mat4 model = Model * d.world;
+    mat3 normalMatrix = Normal * mat3(d.normal);
+    vertexLayers = d.layers.xy;
+#elif defined(INSTANCED)
+    vec3 localPosition = VertexOffset + VertexScale * position;
+    mat4 model = InstanceModel * Model;
+    mat3 normalMatrix = InstanceNormal * Normal;
+#else
+    vec3 localPosition = VertexOffset + VertexScale * position;
+    mat4 model = Model;
+    mat3 normalMatrix = Normal;
+#endif
+
+    vec3 localNormal = PackedNormals ? decodeNormal(normal.xy) : normal;
+
+    vec4 worldPosition = model * vec4(localPosition, 1.0f);
+
+    vertexNormal   = normalMatrix * localNormal;
+    vertexPosition = vec3(worldPosition);
     vertexTexture  = texture;
 
-    gl_Position = Projection * View * Model * vec4(position, 1.0f);
-}
\ No newline at end of file
+    gl_Position = Projection * View * worldPosition;
+}
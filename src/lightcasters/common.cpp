@@ -1,7 +1,7 @@
 #include "common.h"
-#include <FreeImagePlus.h>
+#include "progcache.hpp"
+#include "texture.hpp"
 #include <iostream>
-#include <fstream>
 
 void glc::printErr(int code, const char* desc)
 {
@@ -14,70 +14,48 @@ void glc::printShaderStatus(GLuint shader)
     GLchar infoLog[512];
     glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
 
-    if (! success) {
-        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+    // Shaders makeProgram() found in its cache are never compiled and
+    // carry no log, so only a real failure is printed.
+    GLsizei length = 0;
+    if (! success)
+        glGetShaderInfoLog(shader, 512, &length, infoLog);
+
+    if (length > 0)
         std::cout << infoLog << "\n";
-    }
 }
 
-GLuint glc::makeVShader(std::string path)
+GLuint glc::makeVShader(std::string path, const glc::ShaderDefines& defines)
 {
     auto shader = glCreateShader(GL_VERTEX_SHADER);
-    auto shaderText = makeString(path);
+    auto shaderText = preprocessShader(path, defines);
     auto shaderRawText = shaderText.c_str();
     glShaderSource(shader, 1, &shaderRawText, nullptr);
-    glCompileShader(shader);
+
+    // Compiled by makeProgram(), and only when its binary cache misses.
 
     return shader;
 }
 
-GLuint glc::makeFShader(std::string path)
+GLuint glc::makeFShader(std::string path, const glc::ShaderDefines& defines)
 {
     auto shader = glCreateShader(GL_FRAGMENT_SHADER);
-    auto shaderText = makeString(path);
+    auto shaderText = preprocessShader(path, defines);
     auto shaderRawText = shaderText.c_str();
     glShaderSource(shader, 1, &shaderRawText, nullptr);
-    glCompileShader(shader);
+
+    // Compiled by makeProgram(), and only when its binary cache misses.
 
     return shader;
 }
 
 GLuint glc::makeProgram(std::vector<GLuint> shaders)
 {
-    GLuint program = glCreateProgram();
-
-    for (auto s : shaders)
-        glAttachShader(program, s);
-
-    glLinkProgram(program);
-
-    return program;
+    return glc::makeCachedProgram(shaders, "res/lightcasters");
 }
 
-GLuint glc::makeTexture(std::string path)
+glc::TexHandle glc::makeTexture(std::string path, bool srgb)
 {
-    GLuint id;
-    glGenTextures(1, &id);
-
-    fipImage image;
-    image.load(path.c_str());
-    image.convertTo32Bits();
-    auto data = image.accessPixels();
-    auto w = image.getWidth();
-    auto h = image.getHeight();
-
-    auto minSetting = GL_LINEAR_MIPMAP_LINEAR;
-    auto magSetting = GL_LINEAR;
-
-    glBindTexture(GL_TEXTURE_2D,id);
-    glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,w,h,0,GL_BGRA,GL_UNSIGNED_BYTE,data);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,minSetting);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,magSetting);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D,0);
-    image.clear();
-
-    return id;
+    return glc::loadTextureUnmanaged(path, srgb);
 }
 
 GLuint glc::makeMesh(std::vector<GLfloat> vertices)
@@ -116,25 +94,3 @@ GLuint glc::makeMesh(std::vector<GLfloat> vertices)
 
     return vao;
 }
-
-std::string glc::makeString(std::string path)
-{
-    std::ifstream file(path);
-
-    try
-    {
-        file.exceptions(std::ifstream::failbit);
-    }
-    catch (const std::ios_base::failure& err)
-    {
-        throw std::ios_base::failure(path + " is not available.");
-    }
-
-    file.seekg(0, std::ios::end);
-    auto size = file.tellg();
-    std::string buffer(size, ' ');
-    file.seekg(0);
-    file.read(&buffer[0], size);
-    file.close();
-    return buffer;
-}
\ No newline at end of file
@@ -3,6 +3,9 @@
 #ifndef GLC_COMMON_H
 #define GLC_COMMON_H
 
+#include "preprocess.hpp"
+#include "texture.hpp"
+
 #include <GL/glew.h>
 #include <string>
 #include <vector>
@@ -13,9 +16,10 @@ namespace glc {
     std::string makeString(std::string path);
     GLuint makeMesh(std::vector<GLfloat> vertices);
     GLuint makeShader(GLenum shaderType, std::string text);
-    GLuint makeTexture(std::string path);
-    GLuint makeVShader(std::string path);
-    GLuint makeFShader(std::string path);
+    glc::TexHandle makeTexture(std::string path, bool srgb = true);
+    // Both run the source through glc::preprocessShader() first.
+    GLuint makeVShader(std::string path, const glc::ShaderDefines& defines = glc::ShaderDefines());
+    GLuint makeFShader(std::string path, const glc::ShaderDefines& defines = glc::ShaderDefines());
     GLuint makeProgram(std::vector<GLuint> shaders);
 }
 
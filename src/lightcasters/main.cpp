@@ -1,8 +1,10 @@
 #include "camera.h"
 #include "common.h"
 #include "scene.h"
+#include "uniforms.h"
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include <iostream>
 #include <vector>
 #include <unordered_map>
 
@@ -11,6 +13,14 @@ const auto WINDOW_WIDTH  = 800;
 const auto WINDOW_HEIGHT = 600;
 const auto WINDOW_TITLE  = "GL Cook Book - Playing with Light Casters.";
 
+// Both scenes light the cubes with one light of each type.
+const auto CUBE_DEFINES = glc::ShaderDefines {
+    {"HAS_DIR",          "1"},
+    {"HAS_SPOT",         "1"},
+    {"HAS_SPECULAR_MAP", "1"},
+    {"NUM_POINT_LIGHTS", "1"}
+};
+
 const auto VERTICES = std::vector<GLfloat> {
     // Positions          // Normals           // Texture Coords
     -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
@@ -107,13 +117,14 @@ int main(int argc, char const *argv[])
 
     // CUBE MESH VAO + TEXTURE
     auto cubeMeshId = glc::makeMesh(VERTICES);
+    auto cubeInstances = glc::makeCubeInstances(cubeMeshId);
     auto cubeMeshTex = glc::makeTexture("res/images/box.png");
-    auto cubeMeshSpec = glc::makeTexture("res/images/box_specular.png");
+    auto cubeMeshSpec = glc::makeTexture("res/images/box_specular.png", false);
 
 
     // CUBE SHADER
     auto cubeVShader = glc::makeVShader("res/lightcasters/object_v.glsl");
-    auto cubeFShader = glc::makeFShader("res/lightcasters/object_f.glsl");
+    auto cubeFShader = glc::makeFShader("res/lightcasters/object_f.glsl", CUBE_DEFINES);
     auto cubeShader = glc::makeProgram({cubeVShader, cubeFShader});
     glc::printShaderStatus(cubeVShader);
     glc::printShaderStatus(cubeFShader);
@@ -131,9 +142,36 @@ int main(int argc, char const *argv[])
     glDeleteShader(lampFShader);
 
 
+    // UNIFORM BLOCKS
+    // One buffer per block at a fixed binding point, shared by both programs
+    // and refilled once per frame by the current scene.
+    auto frameBinding = static_cast<GLuint>(glc::BlockBinding::FRAME);
+    auto lightsBinding = static_cast<GLuint>(glc::BlockBinding::LIGHTS);
+
+    GLuint frameBuffer;
+    glGenBuffers(1, &frameBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(glc::FrameBlock), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, frameBinding, frameBuffer);
+
+    GLuint lightsBuffer;
+    glGenBuffers(1, &lightsBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, lightsBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(glc::LightsBlock), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, lightsBinding, lightsBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    for (auto program : {cubeShader, lampShader}) {
+        auto frameIndex = glGetUniformBlockIndex(program, "Frame");
+        glUniformBlockBinding(program, frameIndex, frameBinding);
+    }
+    auto lightsIndex = glGetUniformBlockIndex(cubeShader, "Lights");
+    glUniformBlockBinding(cubeShader, lightsIndex, lightsBinding);
+
+
     auto meshes = std::unordered_map<std::string, glc::Mesh>
     {
-        { "cube", {cubeMeshId, VERTICES.size()} }
+        { "cube", {cubeMeshId, VERTICES.size() / 8} }
     };
 
 
@@ -146,15 +184,22 @@ int main(int argc, char const *argv[])
 
     auto textures = std::unordered_map<std::string, GLuint>
     {
-        { "box",         cubeMeshTex  },
-        { "boxSpecular", cubeMeshSpec }
+        { "box",         *cubeMeshTex  },
+        { "boxSpecular", *cubeMeshSpec }
     };
 
 
-    auto scene01 = glc::BasicScene(window, meshes, shaders, textures);
+    auto buffers = std::unordered_map<std::string, GLuint>
+    {
+        { "frame",  frameBuffer  },
+        { "lights", lightsBuffer }
+    };
+
+
+    auto scene01 = glc::BasicScene(window, meshes, shaders, textures, buffers);
     scene01.setup();
 
-    auto scene02 = glc::BioScene(window, meshes, shaders, textures);
+    auto scene02 = glc::BioScene(window, meshes, shaders, textures, buffers);
     scene02.setup();
 
     auto currentScene = glc::SceneType::BASIC;
@@ -210,8 +255,17 @@ int main(int argc, char const *argv[])
 
 
     // CLEANUP
+    auto& cubeUniforms = glc::getUniforms(cubeShader);
+    std::cout << "Cube uniform updates: " << cubeUniforms.getIssued() << " issued, "
+              << cubeUniforms.getSkipped() << " skipped\n";
+
+    glDeleteBuffers(1, &cubeInstances);
+    glDeleteBuffers(1, &frameBuffer);
+    glDeleteBuffers(1, &lightsBuffer);
     glDeleteProgram(cubeShader);
     glDeleteProgram(lampShader);
+    cubeMeshTex.reset();
+    cubeMeshSpec.reset();
     glfwTerminate();
 
 
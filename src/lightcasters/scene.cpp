@@ -1,8 +1,10 @@
 #include "camera.h"
 #include "scene.h"
+#include "uniforms.h"
 #include <GLFW/glfw3.h>
 #include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
+
+#include <cstddef>
 
 
 const auto MATERIALS = std::unordered_map<std::string, glc::Material> {
@@ -75,15 +77,93 @@ const auto CUBES = std::vector<glc::Cube>{
     { MATERIALS.at("bronze"),       glm::vec3(-1.3f, 1.0f,-1.5f)  }};
 
 
+struct CubeInstance {
+    glm::mat4 model;
+    glm::mat3 normal;
+};
+
+
+GLuint glc::makeCubeInstances(GLuint mesh)
+{
+    // The cubes never move, so this happens once and every scene draws
+    // them all with a single instanced call.
+    auto instances = std::vector<CubeInstance>();
+    for (auto cube : CUBES) {
+        auto model = glm::mat4(1.0f);
+        auto modelRotationAngle = glm::radians(-55.0f);
+        auto modelRotationAxis = glm::vec3(1.0f, 0.3f, 0.5f);
+        model = glm::translate(model, cube.position);
+        model = glm::rotate(model, modelRotationAngle, modelRotationAxis);
+        auto normalMat = glm::mat3(glm::transpose(glm::inverse(model)));
+        instances.push_back(CubeInstance{model, normalMat});
+    }
+
+    GLuint vbo;
+    glGenBuffers(1, &vbo);
+
+    glBindVertexArray(mesh);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(CubeInstance),
+                 instances.data(), GL_STATIC_DRAW);
+
+    auto stride = sizeof(CubeInstance);
+    for (GLuint i = 0; i < 4; i++) {
+        auto offset = (GLvoid*)(offsetof(CubeInstance, model) + i * sizeof(glm::vec4));
+        glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, stride, offset);
+        glEnableVertexAttribArray(3 + i);
+        glVertexAttribDivisor(3 + i, 1);
+    }
+    for (GLuint i = 0; i < 3; i++) {
+        auto offset = (GLvoid*)(offsetof(CubeInstance, normal) + i * sizeof(glm::vec3));
+        glVertexAttribPointer(7 + i, 3, GL_FLOAT, GL_FALSE, stride, offset);
+        glEnableVertexAttribArray(7 + i);
+        glVertexAttribDivisor(7 + i, 1);
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    return vbo;
+}
+
+
+void glc::updateBlocks(GLuint frameBuffer, const glc::FrameBlock& frame,
+                       GLuint lightsBuffer, const glc::LightsBlock& lights)
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frame), &frame);
+    glBindBuffer(GL_UNIFORM_BUFFER, lightsBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(lights), &lights);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+
+glc::SceneUniforms glc::findSceneUniforms(GLuint cubeShader, GLuint lampShader)
+{
+    auto uniforms = glc::SceneUniforms();
+    uniforms.cube = &glc::getUniforms(cubeShader);
+    uniforms.diffuseMap = uniforms.cube->find("Material.kd");
+    uniforms.specularMap = uniforms.cube->find("Material.ks");
+    uniforms.shininess = uniforms.cube->find("Material.a");
+    uniforms.lamp = &glc::getUniforms(lampShader);
+    uniforms.model = uniforms.lamp->find("Model");
+    uniforms.color = uniforms.lamp->find("MainColor");
+    return uniforms;
+}
+
+
 glc::BasicScene::BasicScene(GLFWwindow* window,
     std::unordered_map<std::string, glc::Mesh> meshes,
     std::unordered_map<std::string, GLuint> shaders,
-    std::unordered_map<std::string, GLuint> textures)
+    std::unordered_map<std::string, GLuint> textures,
+    std::unordered_map<std::string, GLuint> buffers)
 : m_window(window),
   m_camera(window),
   m_meshes(meshes),
   m_shaders(shaders),
-  m_textures(textures)
+  m_textures(textures),
+  m_buffers(buffers),
+  m_uniforms()
 {
 
 }
@@ -96,6 +176,7 @@ void glc::BasicScene::setup()
     m_light.pos = glm::vec3(1.2f, 1.0f, 2.0f);
 
     m_camera.setPosition(glm::vec3(0.5f, 0.0f, 5.0f));
+    m_uniforms = glc::findSceneUniforms(m_shaders.at("cube"), m_shaders.at("lamp"));
 }
 
 void glc::BasicScene::update(float diftime)
@@ -120,117 +201,68 @@ void glc::BasicScene::draw()
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    auto cameraPos = m_camera.getPosition();
+    auto cameraDir = m_camera.getDirection();
+
+    auto frame = glc::FrameBlock();
+    frame.view = view;
+    frame.projection = m_projection;
+    frame.cameraPosition = cameraPos;
+
+    auto lights = glc::LightsBlock();
+    lights.dir.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+    lights.dir.ka = glm::vec3(0.1f);
+    lights.dir.kd = m_light.kd;
+    lights.dir.ks = glm::vec3(1.0f);
+
+    lights.points[0].position = m_light.pos;
+    lights.points[0].ka = m_light.ka;
+    lights.points[0].kd = m_light.kd;
+    lights.points[0].ks = glm::vec3(1.0f);
+    lights.points[0].kc = 1.0f;
+    lights.points[0].kl = 0.09f;
+    lights.points[0].kq = 0.032f;
+
+    lights.spot.position = cameraPos;
+    lights.spot.spotDir = cameraDir;
+    lights.spot.ka = m_light.ka;
+    lights.spot.kd = m_light.kd;
+    lights.spot.ks = glm::vec3(1.0f);
+    lights.spot.cutInAngle = glm::cos(glm::radians(12.5f));
+    lights.spot.cutOffAngle = glm::cos(glm::radians(17.5f));
+
+    glc::updateBlocks(m_buffers.at("frame"), frame, m_buffers.at("lights"), lights);
+
     auto cubeShader = m_shaders.at("cube");
     glUseProgram(cubeShader);
 
     {
-        auto matKdId = glGetUniformLocation(cubeShader, "Material.kd");
-        auto matKsId = glGetUniformLocation(cubeShader, "Material.ks");
-        auto matShineId = glGetUniformLocation(cubeShader, "Material.a");
-
-        auto dlightKaId = glGetUniformLocation(cubeShader, "DLight.ka");
-        auto dlightKdId = glGetUniformLocation(cubeShader, "DLight.kd");
-        auto dlightKsId = glGetUniformLocation(cubeShader, "DLight.ks");
-        auto dlightDirId = glGetUniformLocation(cubeShader, "DLight.direction");
-
-        auto plightPosId = glGetUniformLocation(cubeShader, "PLight.position");
-        auto plightKaId = glGetUniformLocation(cubeShader, "PLight.ka");
-        auto plightKdId = glGetUniformLocation(cubeShader, "PLight.kd");
-        auto plightKsId = glGetUniformLocation(cubeShader, "PLight.ks");
-        auto plightKcId = glGetUniformLocation(cubeShader, "PLight.kc");
-        auto plightKlId = glGetUniformLocation(cubeShader, "PLight.kl");
-        auto plightKqId = glGetUniformLocation(cubeShader, "PLight.kq");
-
-        auto slightKaId = glGetUniformLocation(cubeShader, "SLight.ka");
-        auto slightKdId = glGetUniformLocation(cubeShader, "SLight.kd");
-        auto slightKsId = glGetUniformLocation(cubeShader, "SLight.ks");
-        auto slightDirId = glGetUniformLocation(cubeShader, "SLight.spotDir");
-        auto slightPosId = glGetUniformLocation(cubeShader, "SLight.position");
-        auto slightCutOffId = glGetUniformLocation(cubeShader, "SLight.cutOffAngle");
-        auto slightCutInId = glGetUniformLocation(cubeShader, "SLight.cutInAngle");
-
-        auto modelId = glGetUniformLocation(cubeShader, "Model");
-        auto viewId  = glGetUniformLocation(cubeShader, "View");
-        auto projectionId = glGetUniformLocation(cubeShader, "Projection");
-        auto normalMatId  = glGetUniformLocation(cubeShader, "Normal");
-        auto cameraPosId  = glGetUniformLocation(cubeShader, "CameraPosition");
-        auto cameraPos = m_camera.getPosition();
-        auto cameraDir = m_camera.getDirection();
-
-        glUniform3f(dlightDirId, -0.2f, -1.0f, -0.3f);
-        glUniform3f(dlightKaId, 0.1f, 0.1f, 0.1f);
-        glUniform3f(dlightKdId, m_light.kd.r, m_light.kd.g, m_light.kd.b);
-        glUniform3f(dlightKsId, 1.0f, 1.0f, 1.0f);
-
-        glUniform3f(plightPosId, m_light.pos.x, m_light.pos.y, m_light.pos.z);
-        glUniform3f(plightKaId, m_light.ka.r, m_light.ka.g, m_light.ka.b);
-        glUniform3f(plightKdId, m_light.kd.r, m_light.kd.g, m_light.kd.b);
-        glUniform3f(plightKsId, 1.0f, 1.0f, 1.0f);
-        glUniform1f(plightKcId, 1.0f);
-        glUniform1f(plightKlId, 0.09f);
-        glUniform1f(plightKqId, 0.032f);
-
-        glUniform3f(slightPosId, cameraPos.x, cameraPos.y, cameraPos.z);
-        glUniform3f(slightDirId, cameraDir.x, cameraDir.y, cameraDir.z);
-        glUniform3f(slightKaId, m_light.ka.r, m_light.ka.g, m_light.ka.b);
-        glUniform3f(slightKdId, m_light.kd.r, m_light.kd.g, m_light.kd.b);
-        glUniform3f(slightKsId, 1.0f, 1.0f, 1.0f);
-        glUniform1f(slightCutInId, glm::cos(glm::radians(12.5f)));
-        glUniform1f(slightCutOffId, glm::cos(glm::radians(17.5f)));
-
-        glUniformMatrix4fv(viewId, 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(projectionId, 1, GL_FALSE, glm::value_ptr(m_projection));
-        glUniform3f(cameraPosId, cameraPos.x, cameraPos.y, cameraPos.z);
-
-        glUniform1f(matKdId, 0);
+        m_uniforms.cube->set(m_uniforms.diffuseMap, 0);
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, m_textures.at("box"));
 
-        glUniform1f(matKsId, 1);
+        m_uniforms.cube->set(m_uniforms.specularMap, 1);
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, m_textures.at("boxSpecular"));
 
-        glUniform1f(matShineId, 64.0f);
+        m_uniforms.cube->set(m_uniforms.shininess, 64.0f);
 
         glBindVertexArray(m_meshes.at("cube").id);
-        for (auto cube : CUBES) {
-            auto position = cube.position;
-            auto model = glm::mat4(1.0f);
-            auto modelRotationAngle = glm::radians(-55.0f);
-            auto modelRotationAxis = glm::vec3(1.0f, 0.3f, 0.5f);
-            model = glm::translate(model, position);
-            model = glm::rotate(model, modelRotationAngle, modelRotationAxis);
-            auto normalMat = glm::mat3(glm::transpose(glm::inverse(model)));
-            glUniformMatrix3fv(normalMatId, 1, GL_FALSE, glm::value_ptr(normalMat));
-            glUniformMatrix4fv(modelId, 1, GL_FALSE, glm::value_ptr(model));
-            glDrawArrays(GL_TRIANGLES, 0, m_meshes.at("cube").size);
-        }
+        glDrawArraysInstanced(GL_TRIANGLES, 0, m_meshes.at("cube").size, CUBES.size());
         glBindVertexArray(0);
-
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, 0);
     }
 
     auto lampShader = m_shaders.at("lamp");
     glUseProgram(lampShader);
 
     {
-        auto modelId = glGetUniformLocation(lampShader, "Model");
-        auto viewId = glGetUniformLocation(lampShader, "View");
-        auto projectionId = glGetUniformLocation(lampShader, "Projection");
-        auto mainColorId = glGetUniformLocation(lampShader, "MainColor");
-
         auto model = glm::mat4(1.0f);
         model = glm::translate(model, m_light.pos);
         model = glm::scale(model, glm::vec3(0.2f));
 
-        glUniformMatrix4fv(modelId, 1, GL_FALSE, glm::value_ptr(model));
-        glUniformMatrix4fv(viewId, 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(projectionId, 1, GL_FALSE, glm::value_ptr(m_projection));
+        m_uniforms.lamp->set(m_uniforms.model, model);
 
-        glUniform3f(mainColorId, m_light.kd.r, m_light.kd.g, m_light.kd.b);
+        m_uniforms.lamp->set(m_uniforms.color, m_light.kd);
 
         glBindVertexArray(m_meshes.at("cube").id);
         glDrawArrays(GL_TRIANGLES, 0, m_meshes.at("cube").size);
@@ -243,12 +275,15 @@ void glc::BasicScene::draw()
 glc::BioScene::BioScene(GLFWwindow* window,
     std::unordered_map<std::string, glc::Mesh> meshes,
     std::unordered_map<std::string, GLuint> shaders,
-    std::unordered_map<std::string, GLuint> textures)
+    std::unordered_map<std::string, GLuint> textures,
+    std::unordered_map<std::string, GLuint> buffers)
 : m_window(window),
   m_camera(window),
   m_meshes(meshes),
   m_shaders(shaders),
-  m_textures(textures)
+  m_textures(textures),
+  m_buffers(buffers),
+  m_uniforms()
 {
 
 }
@@ -261,6 +296,7 @@ void glc::BioScene::setup()
     m_light.pos = glm::vec3(1.2f, 1.0f, 2.0f);
 
     m_camera.setPosition(glm::vec3(0.5f, 0.0f, 5.0f));
+    m_uniforms = glc::findSceneUniforms(m_shaders.at("cube"), m_shaders.at("lamp"));
 }
 
 void glc::BioScene::update(float diftime)
@@ -285,117 +321,68 @@ void glc::BioScene::draw()
     glClearColor(0.9f, 0.9f, 0.9f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    auto cameraPos = m_camera.getPosition();
+    auto cameraDir = m_camera.getDirection();
+
+    auto frame = glc::FrameBlock();
+    frame.view = view;
+    frame.projection = m_projection;
+    frame.cameraPosition = cameraPos;
+
+    auto lights = glc::LightsBlock();
+    lights.dir.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+    lights.dir.ka = glm::vec3(0.1f);
+    lights.dir.kd = glm::vec3(1.0f);
+    lights.dir.ks = glm::vec3(1.0f);
+
+    lights.points[0].position = m_light.pos;
+    lights.points[0].ka = m_light.ka;
+    lights.points[0].kd = m_light.kd;
+    lights.points[0].ks = m_light.ks;
+    lights.points[0].kc = 1.0f;
+    lights.points[0].kl = 0.09f;
+    lights.points[0].kq = 0.032f;
+
+    lights.spot.position = cameraPos;
+    lights.spot.spotDir = cameraDir;
+    lights.spot.ka = m_light.ka;
+    lights.spot.kd = glm::vec3(0.0f);
+    lights.spot.ks = glm::vec3(1.0f);
+    lights.spot.cutInAngle = glm::cos(glm::radians(12.5f));
+    lights.spot.cutOffAngle = glm::cos(glm::radians(17.5f));
+
+    glc::updateBlocks(m_buffers.at("frame"), frame, m_buffers.at("lights"), lights);
+
     auto cubeShader = m_shaders.at("cube");
     glUseProgram(cubeShader);
 
     {
-        auto matKdId = glGetUniformLocation(cubeShader, "Material.kd");
-        auto matKsId = glGetUniformLocation(cubeShader, "Material.ks");
-        auto matShineId = glGetUniformLocation(cubeShader, "Material.a");
-
-        auto dlightKaId = glGetUniformLocation(cubeShader, "DLight.ka");
-        auto dlightKdId = glGetUniformLocation(cubeShader, "DLight.kd");
-        auto dlightKsId = glGetUniformLocation(cubeShader, "DLight.ks");
-        auto dlightDirId = glGetUniformLocation(cubeShader, "DLight.direction");
-
-        auto plightPosId = glGetUniformLocation(cubeShader, "PLight.position");
-        auto plightKaId = glGetUniformLocation(cubeShader, "PLight.ka");
-        auto plightKdId = glGetUniformLocation(cubeShader, "PLight.kd");
-        auto plightKsId = glGetUniformLocation(cubeShader, "PLight.ks");
-        auto plightKcId = glGetUniformLocation(cubeShader, "PLight.kc");
-        auto plightKlId = glGetUniformLocation(cubeShader, "PLight.kl");
-        auto plightKqId = glGetUniformLocation(cubeShader, "PLight.kq");
-
-        auto slightKaId = glGetUniformLocation(cubeShader, "SLight.ka");
-        auto slightKdId = glGetUniformLocation(cubeShader, "SLight.kd");
-        auto slightKsId = glGetUniformLocation(cubeShader, "SLight.ks");
-        auto slightDirId = glGetUniformLocation(cubeShader, "SLight.spotDir");
-        auto slightPosId = glGetUniformLocation(cubeShader, "SLight.position");
-        auto slightCutOffId = glGetUniformLocation(cubeShader, "SLight.cutOffAngle");
-        auto slightCutInId = glGetUniformLocation(cubeShader, "SLight.cutInAngle");
-
-        auto modelId = glGetUniformLocation(cubeShader, "Model");
-        auto viewId  = glGetUniformLocation(cubeShader, "View");
-        auto projectionId = glGetUniformLocation(cubeShader, "Projection");
-        auto normalMatId  = glGetUniformLocation(cubeShader, "Normal");
-        auto cameraPosId  = glGetUniformLocation(cubeShader, "CameraPosition");
-        auto cameraPos = m_camera.getPosition();
-        auto cameraDir = m_camera.getDirection();
-
-        glUniform3f(dlightDirId, -0.2f, -1.0f, -0.3f);
-        glUniform3f(dlightKaId, 0.1f, 0.1f, 0.1f);
-        glUniform3f(dlightKdId, 1.0f, 1.0f, 1.0f);
-        glUniform3f(dlightKsId, 1.0f, 1.0f, 1.0f);
-
-        glUniform3f(plightPosId, m_light.pos.x, m_light.pos.y, m_light.pos.z);
-        glUniform3f(plightKaId, m_light.ka.r, m_light.ka.g, m_light.ka.b);
-        glUniform3f(plightKdId, m_light.kd.r, m_light.kd.g, m_light.kd.b);
-        glUniform3f(plightKsId, m_light.ks.r, m_light.ks.g, m_light.ks.b);
-        glUniform1f(plightKcId, 1.0f);
-        glUniform1f(plightKlId, 0.09f);
-        glUniform1f(plightKqId, 0.032f);
-
-        glUniform3f(slightPosId, cameraPos.x, cameraPos.y, cameraPos.z);
-        glUniform3f(slightDirId, cameraDir.x, cameraDir.y, cameraDir.z);
-        glUniform3f(slightKaId, m_light.ka.r, m_light.ka.g, m_light.ka.b);
-        glUniform3f(slightKdId, 0.0f, 0.0f, 0.0f);
-        glUniform3f(slightKsId, 1.0f, 1.0f, 1.0f);
-        glUniform1f(slightCutInId, glm::cos(glm::radians(12.5f)));
-        glUniform1f(slightCutOffId, glm::cos(glm::radians(17.5f)));
-
-        glUniformMatrix4fv(viewId, 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(projectionId, 1, GL_FALSE, glm::value_ptr(m_projection));
-        glUniform3f(cameraPosId, cameraPos.x, cameraPos.y, cameraPos.z);
-
-        glUniform1f(matKdId, 0);
+        m_uniforms.cube->set(m_uniforms.diffuseMap, 0);
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, m_textures.at("box"));
 
-        glUniform1f(matKsId, 1);
+        m_uniforms.cube->set(m_uniforms.specularMap, 1);
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, m_textures.at("boxSpecular"));
 
-        glUniform1f(matShineId, 64.0f);
+        m_uniforms.cube->set(m_uniforms.shininess, 64.0f);
 
         glBindVertexArray(m_meshes.at("cube").id);
-        for (auto cube : CUBES) {
-            auto position = cube.position;
-            auto model = glm::mat4(1.0f);
-            auto modelRotationAngle = glm::radians(-55.0f);
-            auto modelRotationAxis = glm::vec3(1.0f, 0.3f, 0.5f);
-            model = glm::translate(model, position);
-            model = glm::rotate(model, modelRotationAngle, modelRotationAxis);
-            auto normalMat = glm::mat3(glm::transpose(glm::inverse(model)));
-            glUniformMatrix3fv(normalMatId, 1, GL_FALSE, glm::value_ptr(normalMat));
-            glUniformMatrix4fv(modelId, 1, GL_FALSE, glm::value_ptr(model));
-            glDrawArrays(GL_TRIANGLES, 0, m_meshes.at("cube").size);
-        }
+        glDrawArraysInstanced(GL_TRIANGLES, 0, m_meshes.at("cube").size, CUBES.size());
         glBindVertexArray(0);
-
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, 0);
     }
 
     auto lampShader = m_shaders.at("lamp");
     glUseProgram(lampShader);
 
     {
-        auto modelId = glGetUniformLocation(lampShader, "Model");
-        auto viewId = glGetUniformLocation(lampShader, "View");
-        auto projectionId = glGetUniformLocation(lampShader, "Projection");
-        auto mainColorId = glGetUniformLocation(lampShader, "MainColor");
-
         auto model = glm::mat4(1.0f);
         model = glm::translate(model, m_light.pos);
         model = glm::scale(model, glm::vec3(0.2f));
 
-        glUniformMatrix4fv(modelId, 1, GL_FALSE, glm::value_ptr(model));
-        glUniformMatrix4fv(viewId, 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(projectionId, 1, GL_FALSE, glm::value_ptr(m_projection));
+        m_uniforms.lamp->set(m_uniforms.model, model);
 
-        glUniform3f(mainColorId, m_light.kd.r, m_light.kd.g, m_light.kd.b);
+        m_uniforms.lamp->set(m_uniforms.color, m_light.kd);
 
         glBindVertexArray(m_meshes.at("cube").id);
         glDrawArrays(GL_TRIANGLES, 0, m_meshes.at("cube").size);
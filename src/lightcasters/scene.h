@@ -3,6 +3,8 @@
 #ifndef GLC_SCENE_H
 #define GLC_SCENE_H
 
+#include "blocks.hpp"
+
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <unordered_map>
@@ -13,6 +15,8 @@ struct GLFWwindow;
 
 namespace glc {
 
+    class Uniforms;
+
     struct Mesh {
         GLuint id;
         size_t size;
@@ -37,6 +41,31 @@ namespace glc {
         glm::vec3 position;
     };
 
+    // Uploads the transforms of the scenes' cubes and hooks them up to the
+    // cube mesh as per-instance attributes: the model matrix at locations
+    // 3-6 and the normal matrix at 7-9. Returns the buffer.
+    GLuint makeCubeInstances(GLuint mesh);
+
+    // Fills the Frame and Lights uniform buffers, bound at their
+    // glc::BlockBinding points, with one glBufferSubData each.
+    void updateBlocks(GLuint frameBuffer, const glc::FrameBlock& frame,
+                      GLuint lightsBuffer, const glc::LightsBlock& lights);
+
+    // The cube and lamp programs' uniform shadows, with the handles the
+    // scenes set every frame.
+    struct SceneUniforms {
+        glc::Uniforms* cube;
+        GLint diffuseMap;
+        GLint specularMap;
+        GLint shininess;
+        glc::Uniforms* lamp;
+        GLint model;
+        GLint color;
+    };
+
+    // Resolves every handle once, for the scenes' setup().
+    glc::SceneUniforms findSceneUniforms(GLuint cubeShader, GLuint lampShader);
+
     enum class SceneType {
         BASIC,
         BIO
@@ -47,7 +76,8 @@ namespace glc {
         BasicScene(GLFWwindow* window,
             std::unordered_map<std::string, glc::Mesh> meshes,
             std::unordered_map<std::string, GLuint> shaders,
-            std::unordered_map<std::string, GLuint> textures);
+            std::unordered_map<std::string, GLuint> textures,
+            std::unordered_map<std::string, GLuint> buffers);
         void setup();
         void update(float diftime);
         void draw();
@@ -57,6 +87,8 @@ namespace glc {
         std::unordered_map<std::string, glc::Mesh> m_meshes;
         std::unordered_map<std::string, GLuint> m_shaders;
         std::unordered_map<std::string, GLuint> m_textures;
+        std::unordered_map<std::string, GLuint> m_buffers;
+        glc::SceneUniforms m_uniforms;
         glc::Light m_light;
         glm::mat4 m_projection;
     };
@@ -66,7 +98,8 @@ namespace glc {
         BioScene(GLFWwindow* window,
             std::unordered_map<std::string, glc::Mesh> meshes,
             std::unordered_map<std::string, GLuint> shaders,
-            std::unordered_map<std::string, GLuint> textures);
+            std::unordered_map<std::string, GLuint> textures,
+            std::unordered_map<std::string, GLuint> buffers);
         void setup();
         void update(float diftime);
         void draw();
@@ -76,6 +109,8 @@ namespace glc {
         std::unordered_map<std::string, glc::Mesh> m_meshes;
         std::unordered_map<std::string, GLuint> m_shaders;
         std::unordered_map<std::string, GLuint> m_textures;
+        std::unordered_map<std::string, GLuint> m_buffers;
+        glc::SceneUniforms m_uniforms;
         glc::Light m_light;
         glm::mat4 m_projection;
     };
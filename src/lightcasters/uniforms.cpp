@@ -0,0 +1,95 @@
+#include "uniforms.h"
+#include <glm/gtc/type_ptr.hpp>
+
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+
+
+glc::Uniforms::Uniforms(GLuint program)
+: m_program(program),
+  m_entries(),
+  m_issued(0),
+  m_skipped(0)
+{
+
+}
+
+GLint glc::Uniforms::find(const std::string& name)
+{
+    auto location = glGetUniformLocation(m_program, name.c_str());
+    if (location < 0)
+        return -1;
+
+    // One entry per location, so every handle sees the same last value.
+    for (size_t i = 0; i < m_entries.size(); i++) {
+        if (m_entries[i].location == location)
+            return GLint(i);
+    }
+
+    m_entries.push_back(Entry{location, {}});
+    return GLint(m_entries.size() - 1);
+}
+
+void glc::Uniforms::set(GLint uniform, GLint value)
+{
+    if (auto entry = update(uniform, &value, sizeof(value)))
+        glUniform1i(entry->location, value);
+}
+
+void glc::Uniforms::set(GLint uniform, GLfloat value)
+{
+    if (auto entry = update(uniform, &value, sizeof(value)))
+        glUniform1f(entry->location, value);
+}
+
+void glc::Uniforms::set(GLint uniform, glm::vec3 value)
+{
+    if (auto entry = update(uniform, &value, sizeof(value)))
+        glUniform3f(entry->location, value.x, value.y, value.z);
+}
+
+void glc::Uniforms::set(GLint uniform, glm::mat4 value)
+{
+    if (auto entry = update(uniform, &value, sizeof(value)))
+        glUniformMatrix4fv(entry->location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+size_t glc::Uniforms::getIssued() const
+{
+    return m_issued;
+}
+
+size_t glc::Uniforms::getSkipped() const
+{
+    return m_skipped;
+}
+
+glc::Uniforms::Entry* glc::Uniforms::update(GLint uniform, const void* value, size_t size)
+{
+    // Uniforms the program doesn't have are dropped like GL drops location -1.
+    if (uniform < 0)
+        return nullptr;
+
+    auto& entry = m_entries[uniform];
+    if (entry.value.size() == size && std::memcmp(entry.value.data(), value, size) == 0) {
+        m_skipped++;
+        return nullptr;
+    }
+
+    auto bytes = static_cast<const unsigned char*>(value);
+    entry.value.assign(bytes, bytes + size);
+    m_issued++;
+    return &entry;
+}
+
+glc::Uniforms& glc::getUniforms(GLuint program)
+{
+    static auto shadows = std::unordered_map<GLuint, std::unique_ptr<glc::Uniforms>>();
+
+    auto& shadow = shadows[program];
+    if (! shadow)
+        shadow.reset(new glc::Uniforms(program));
+
+    return *shadow;
+}
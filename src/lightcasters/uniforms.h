@@ -0,0 +1,50 @@
+#pragma once
+
+#ifndef GLC_UNIFORMS_H
+#define GLC_UNIFORMS_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+namespace glc {
+
+    // Shadow copy of one program's uniforms. This sample keeps its own on
+    // purpose: its programs are raw GL names from makeProgram(), not the
+    // glc::Shader objects the models sample shadows. Names are resolved to
+    // handles once, and a set() matching the value the program already
+    // holds never reaches GL. The program must be in use when setting.
+    class Uniforms {
+    public:
+        explicit Uniforms(GLuint program);
+        // Handle for set(); -1 if the program has no such uniform, which
+        // set() then ignores. Finding a name twice gives the same handle.
+        GLint find(const std::string& name);
+        void set(GLint uniform, GLint value);
+        void set(GLint uniform, GLfloat value);
+        void set(GLint uniform, glm::vec3 value);
+        void set(GLint uniform, glm::mat4 value);
+        size_t getIssued() const;
+        size_t getSkipped() const;
+    private:
+        struct Entry {
+            GLint location;
+            std::vector<unsigned char> value;
+        };
+
+        GLuint m_program;
+        std::vector<Entry> m_entries;
+        size_t m_issued;
+        size_t m_skipped;
+
+        // Helper Methods
+        Entry* update(GLint uniform, const void* value, size_t size);
+    };
+
+    // One shadow per program, shared by every scene drawing with it.
+    glc::Uniforms& getUniforms(GLuint program);
+
+}
+
+#endif
@@ -1,9 +1,8 @@
 #include "common.h"
+#include "progcache.hpp"
 
 #include <GL/glew.h>
-#include <FreeImagePlus.h>
 #include <iostream>
-#include <fstream>
 #include <string>
 #include <vector>
 
@@ -18,10 +17,14 @@ void glc::printShaderStatus(GLuint shader)
     GLchar infoLog[512];
     glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
 
-    if (! success) {
-        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+    // Shaders makeProgram() found in its cache are never compiled and
+    // carry no log, so only a real failure is printed.
+    GLsizei length = 0;
+    if (! success)
+        glGetShaderInfoLog(shader, 512, &length, infoLog);
+
+    if (length > 0)
         std::cout << infoLog << "\n";
-    }
 }
 
 GLuint glc::makeVShader(std::string path)
@@ -30,7 +33,8 @@ GLuint glc::makeVShader(std::string path)
     auto shaderText = makeString(path);
     auto shaderRawText = shaderText.c_str();
     glShaderSource(shader, 1, &shaderRawText, nullptr);
-    glCompileShader(shader);
+
+    // Compiled by makeProgram(), and only when its binary cache misses.
 
     return shader;
 }
@@ -41,21 +45,15 @@ GLuint glc::makeFShader(std::string path)
     auto shaderText = makeString(path);
     auto shaderRawText = shaderText.c_str();
     glShaderSource(shader, 1, &shaderRawText, nullptr);
-    glCompileShader(shader);
+
+    // Compiled by makeProgram(), and only when its binary cache misses.
 
     return shader;
 }
 
 GLuint glc::makeProgram(std::vector<GLuint> shaders)
 {
-    GLuint program = glCreateProgram();
-
-    for (auto s : shaders)
-        glAttachShader(program, s);
-
-    glLinkProgram(program);
-
-    return program;
+    return glc::makeCachedProgram(shaders, "res/lightmaps");
 }
 
 GLuint glc::makeMesh(std::vector<GLfloat> vertices)
@@ -94,25 +92,3 @@ GLuint glc::makeMesh(std::vector<GLfloat> vertices)
 
     return vao;
 }
-
-std::string glc::makeString(std::string path)
-{
-    std::ifstream file(path);
-
-    try
-    {
-        file.exceptions(std::ifstream::failbit);
-    }
-    catch (const std::ios_base::failure& err)
-    {
-        throw std::ios_base::failure(path + " is not available.");
-    }
-
-    file.seekg(0, std::ios::end);
-    auto size = file.tellg();
-    std::string buffer(size, ' ');
-    file.seekg(0);
-    file.read(&buffer[0], size);
-    file.close();
-    return buffer;
-}
\ No newline at end of file
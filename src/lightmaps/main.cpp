@@ -9,6 +9,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <cstddef>
 #include <vector>
 #include <unordered_map>
 
@@ -31,6 +32,13 @@ struct Cube {
     glm::vec3 position;
 };
 
+// Per-instance attributes: model matrix at locations 3-6 and normal
+// matrix at 7-9.
+struct Instance {
+    glm::mat4 model;
+    glm::mat3 normal;
+};
+
 
 const auto WINDOW_WIDTH  = 800;
 const auto WINDOW_HEIGHT = 600;
@@ -136,7 +144,7 @@ int main(int argc, char const *argv[])
     // CUBE MESH VAO + TEXTURE
     auto cubeMeshId = glc::makeMesh(VERTICES);
     auto cubeMeshTex = texLoader.load("res/images/box.png");
-    auto cubeMeshSpec = texLoader.load("res/images/box_specular.png");
+    auto cubeMeshSpec = texLoader.load("res/images/box_specular.png", false);
 
 
     // CUBE SHADER
@@ -263,6 +271,44 @@ int main(int argc, char const *argv[])
     };
 
 
+    // The cubes never move, so their transforms go up once and every cube
+    // is drawn by a single instanced call.
+    auto instances = std::vector<Instance>();
+    for (auto cube : cubes) {
+        auto model = glm::mat4(1.0f);
+        auto modelRotationAngle = glm::radians(-55.0f);
+        auto modelRotationAxis = glm::vec3(1.0f, 0.3f, 0.5f);
+        model = glm::translate(model, cube.position);
+        model = glm::rotate(model, modelRotationAngle, modelRotationAxis);
+        auto normalMat = glm::mat3(glm::transpose(glm::inverse(model)));
+        instances.push_back(Instance{model, normalMat});
+    }
+
+    GLuint instanceBuffer;
+    glGenBuffers(1, &instanceBuffer);
+    glBindVertexArray(cubeMeshId);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance),
+                 instances.data(), GL_STATIC_DRAW);
+
+    auto instanceStride = sizeof(Instance);
+    for (GLuint i = 0; i < 4; i++) {
+        auto offset = (GLvoid*)(offsetof(Instance, model) + i * sizeof(glm::vec4));
+        glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, instanceStride, offset);
+        glEnableVertexAttribArray(3 + i);
+        glVertexAttribDivisor(3 + i, 1);
+    }
+    for (GLuint i = 0; i < 3; i++) {
+        auto offset = (GLvoid*)(offsetof(Instance, normal) + i * sizeof(glm::vec3));
+        glVertexAttribPointer(7 + i, 3, GL_FLOAT, GL_FALSE, instanceStride, offset);
+        glEnableVertexAttribArray(7 + i);
+        glVertexAttribDivisor(7 + i, 1);
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+
     /*
      __  __          _____ _   _   _      ____   ____  _____
     |  \/  |   /\   |_   _| \ | | | |    / __ \ / __ \|  __ \
@@ -312,10 +358,8 @@ int main(int argc, char const *argv[])
             auto lightKdId = glGetUniformLocation(objectShader, "Light.kd");
             auto lightKsId = glGetUniformLocation(objectShader, "Light.ks");
             auto lightPosId = glGetUniformLocation(objectShader, "Light.position");
-            auto modelId = glGetUniformLocation(objectShader, "Model");
             auto viewId  = glGetUniformLocation(objectShader, "View");
             auto projectionId = glGetUniformLocation(objectShader, "Projection");
-            auto normalMatId  = glGetUniformLocation(objectShader, "Normal");
             auto cameraPosId  = glGetUniformLocation(objectShader, "CameraPosition");
             auto cameraPos = camera.getPosition();
 
@@ -330,33 +374,17 @@ int main(int argc, char const *argv[])
 
             glUniform1f(matKdId, 0);
             glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, cubeMeshTex);
+            glBindTexture(GL_TEXTURE_2D, *cubeMeshTex);
 
             glUniform1f(matKsId, 1);
             glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, cubeMeshSpec);
+            glBindTexture(GL_TEXTURE_2D, *cubeMeshSpec);
 
             glUniform1f(matShineId, 64.0f);
 
             glBindVertexArray(cubeMeshId);
-            for (auto cube : cubes) {
-                auto position = cube.position;
-                auto model = glm::mat4(1.0f);
-                auto modelRotationAngle = glm::radians(-55.0f);
-                auto modelRotationAxis = glm::vec3(1.0f, 0.3f, 0.5f);
-                model = glm::translate(model, position);
-                model = glm::rotate(model, modelRotationAngle, modelRotationAxis);
-                auto normalMat = glm::mat3(glm::transpose(glm::inverse(model)));
-                glUniformMatrix3fv(normalMatId, 1, GL_FALSE, glm::value_ptr(normalMat));
-                glUniformMatrix4fv(modelId, 1, GL_FALSE, glm::value_ptr(model));
-                glDrawArrays(GL_TRIANGLES, 0, VERTICES.size());
-            }
+            glDrawArraysInstanced(GL_TRIANGLES, 0, VERTICES.size() / 8, instances.size());
             glBindVertexArray(0);
-
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, 0);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, 0);
         }
 
         glUseProgram(lampShader);
@@ -375,7 +403,7 @@ int main(int argc, char const *argv[])
             glUniformMatrix4fv(projectionId, 1, GL_FALSE, glm::value_ptr(projection));
 
             glBindVertexArray(cubeMeshId);
-            glDrawArrays(GL_TRIANGLES, 0, VERTICES.size());
+            glDrawArrays(GL_TRIANGLES, 0, VERTICES.size() / 8);
             glBindVertexArray(0);
         }
 
@@ -386,8 +414,11 @@ int main(int argc, char const *argv[])
 
 
     // CLEANUP
+    glDeleteBuffers(1, &instanceBuffer);
     glDeleteProgram(objectShader);
     glDeleteProgram(lampShader);
+    cubeMeshTex.reset();
+    cubeMeshSpec.reset();
     glfwTerminate();
 
 
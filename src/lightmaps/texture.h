@@ -3,17 +3,16 @@
 #ifndef GLC_TEXTURE_H
 #define GLC_TEXTURE_H
 
+#include "texture.hpp"
+
 #include <GL/glew.h>
-#include <FreeImagePlus.h>
 #include <string>
 
 namespace glc {
     class TexLoader {
         public:
             TexLoader();
-            GLuint load(std::string path);
-        private:
-            fipImage m_container;
+            glc::TexHandle load(std::string path, bool srgb = true);
     };
 }
 
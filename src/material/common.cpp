@@ -1,9 +1,9 @@
 #include "common.h"
+#include "progcache.hpp"
+#include "texture.hpp"
 
 #include <GL/glew.h>
-#include <FreeImagePlus.h>
 #include <iostream>
-#include <fstream>
 #include <string>
 #include <vector>
 
@@ -18,10 +18,14 @@ void glc::printShaderStatus(GLuint shader)
     GLchar infoLog[512];
     glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
 
-    if (! success) {
-        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+    // Shaders makeProgram() found in its cache are never compiled and
+    // carry no log, so only a real failure is printed.
+    GLsizei length = 0;
+    if (! success)
+        glGetShaderInfoLog(shader, 512, &length, infoLog);
+
+    if (length > 0)
         std::cout << infoLog << "\n";
-    }
 }
 
 GLuint glc::makeVShader(std::string path)
@@ -30,7 +34,8 @@ GLuint glc::makeVShader(std::string path)
     auto shaderText = makeString(path);
     auto shaderRawText = shaderText.c_str();
     glShaderSource(shader, 1, &shaderRawText, nullptr);
-    glCompileShader(shader);
+
+    // Compiled by makeProgram(), and only when its binary cache misses.
 
     return shader;
 }
@@ -41,48 +46,20 @@ GLuint glc::makeFShader(std::string path)
     auto shaderText = makeString(path);
     auto shaderRawText = shaderText.c_str();
     glShaderSource(shader, 1, &shaderRawText, nullptr);
-    glCompileShader(shader);
+
+    // Compiled by makeProgram(), and only when its binary cache misses.
 
     return shader;
 }
 
 GLuint glc::makeProgram(std::vector<GLuint> shaders)
 {
-    GLuint program = glCreateProgram();
-
-    for (auto s : shaders)
-        glAttachShader(program, s);
-
-    glLinkProgram(program);
-
-    return program;
+    return glc::makeCachedProgram(shaders, "res/material");
 }
 
-GLuint glc::makeTexture(std::string path)
+glc::TexHandle glc::makeTexture(std::string path, bool srgb)
 {
-    GLuint id;
-    glGenTextures(1, &id);
-
-    fipImage image;
-    image.load(path.c_str());
-    image.convertTo32Bits();
-
-    auto data = image.accessPixels();
-    auto w = image.getWidth();
-    auto h = image.getHeight();
-
-    auto minSetting = GL_LINEAR_MIPMAP_LINEAR;
-    auto magSetting = GL_LINEAR;
-
-    glBindTexture(GL_TEXTURE_2D,id);
-    glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,w,h,0,GL_BGRA,GL_UNSIGNED_BYTE,data);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,minSetting);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,magSetting);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    image.clear();
-
-    return id;
+    return glc::loadTextureUnmanaged(path, srgb);
 }
 
 GLuint glc::makeMesh(std::vector<GLfloat> vertices)
@@ -117,25 +94,3 @@ GLuint glc::makeMesh(std::vector<GLfloat> vertices)
 
     return vao;
 }
-
-std::string glc::makeString(std::string path)
-{
-    std::ifstream file(path);
-
-    try
-    {
-        file.exceptions(std::ifstream::failbit);
-    }
-    catch (const std::ios_base::failure& err)
-    {
-        throw std::ios_base::failure(path + " is not available.");
-    }
-
-    file.seekg(0, std::ios::end);
-    auto size = file.tellg();
-    std::string buffer(size, ' ');
-    file.seekg(0);
-    file.read(&buffer[0], size);
-    file.close();
-    return buffer;
-}
\ No newline at end of file
@@ -3,6 +3,8 @@
 #ifndef GLC_COMMON_H
 #define GLC_COMMON_H
 
+#include "texture.hpp"
+
 #include <GL/glew.h>
 #include <string>
 #include <vector>
@@ -16,7 +18,7 @@ namespace glc {
     GLuint makeShader(GLenum shaderType, std::string text);
     GLuint makeVShader(std::string path);
     GLuint makeFShader(std::string path);
-    GLuint makeTexture(std::string path);
+    glc::TexHandle makeTexture(std::string path, bool srgb = true);
     GLuint makeProgram(std::vector<GLuint> shaders);
 
 }
@@ -8,6 +8,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <cstddef>
 #include <vector>
 #include <unordered_map>
 
@@ -25,16 +26,37 @@ struct Material {
     float sh;
 };
 
+// std140 layout of object_f.glsl's material struct, one palette entry.
+struct MaterialBlock {
+    glm::vec3 ka;
+    float pad0;
+    glm::vec3 kd;
+    float pad1;
+    glm::vec3 ks;
+    float sh;
+};
+
 struct Cube {
-    Material  material;
+    GLint     material;
     glm::vec3 position;
 };
 
+// Per-instance attributes: model matrix at locations 2-5, normal matrix
+// at 6-8 and the palette index at 9.
+struct Instance {
+    glm::mat4 model;
+    glm::mat3 normal;
+    GLint     material;
+};
+
 
 const auto WINDOW_WIDTH  = 800;
 const auto WINDOW_HEIGHT = 600;
 const auto WINDOW_TITLE  = "GL Cook Book - Playing with Material.";
 const auto RATIO = static_cast<float>(WINDOW_WIDTH/WINDOW_HEIGHT);
+// Must match MAX_MATERIALS in object_f.glsl.
+const auto MAX_MATERIALS = 16;
+const auto MATERIALS_BINDING = 0;
 const auto VERTICES = std::vector<GLfloat> {
     -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
      0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
@@ -243,20 +265,75 @@ int main(int argc, char const *argv[])
 
     */
 
+    // Every material goes up once; cubes refer to theirs by index.
+    auto palette = std::vector<MaterialBlock>();
+    auto paletteIndex = std::unordered_map<std::string, GLint>();
+    for (const auto& entry : materials) {
+        auto material = entry.second;
+        paletteIndex.emplace(entry.first, static_cast<GLint>(palette.size()));
+        palette.push_back(MaterialBlock{
+            material.ka, 0.0f, material.kd, 0.0f, material.ks, material.sh
+        });
+    }
+    palette.resize(MAX_MATERIALS);
+
+    GLuint paletteBuffer;
+    glGenBuffers(1, &paletteBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, paletteBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, palette.size() * sizeof(MaterialBlock),
+                 palette.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, MATERIALS_BINDING, paletteBuffer);
+
+    auto materialsIndex = glGetUniformBlockIndex(objectShader, "Materials");
+    glUniformBlockBinding(objectShader, materialsIndex, MATERIALS_BINDING);
+
     auto cubes = std::vector<Cube>{
-        { materials.at("cyan_plastic"), glm::vec3( 0.0f, 0.0f, 0.0f)  },
-        { materials.at("emerald"),      glm::vec3( 2.0f, 5.0f,-15.0f) },
-        { materials.at("ruby"),         glm::vec3(-1.5f,-2.2f,-2.5f)  },
-        { materials.at("emerald"),      glm::vec3(-3.8f,-2.0f,-12.3f) },
-        { materials.at("pearl"),        glm::vec3( 2.4f,-0.4f,-3.5f)  },
-        { materials.at("pearl"),        glm::vec3(-1.7f, 3.0f,-7.5f)  },
-        { materials.at("obsidian"),     glm::vec3( 1.3f,-2.0f,-2.5f)  },
-        { materials.at("gold"),         glm::vec3( 1.5f, 2.0f,-2.5f)  },
-        { materials.at("jade"),         glm::vec3( 1.5f, 0.2f,-1.5f)  },
-        { materials.at("bronze"),       glm::vec3(-1.3f, 1.0f,-1.5f)  }
+        { paletteIndex.at("cyan_plastic"), glm::vec3( 0.0f, 0.0f, 0.0f)  },
+        { paletteIndex.at("emerald"),      glm::vec3( 2.0f, 5.0f,-15.0f) },
+        { paletteIndex.at("ruby"),         glm::vec3(-1.5f,-2.2f,-2.5f)  },
+        { paletteIndex.at("emerald"),      glm::vec3(-3.8f,-2.0f,-12.3f) },
+        { paletteIndex.at("pearl"),        glm::vec3( 2.4f,-0.4f,-3.5f)  },
+        { paletteIndex.at("pearl"),        glm::vec3(-1.7f, 3.0f,-7.5f)  },
+        { paletteIndex.at("obsidian"),     glm::vec3( 1.3f,-2.0f,-2.5f)  },
+        { paletteIndex.at("gold"),         glm::vec3( 1.5f, 2.0f,-2.5f)  },
+        { paletteIndex.at("jade"),         glm::vec3( 1.5f, 0.2f,-1.5f)  },
+        { paletteIndex.at("bronze"),       glm::vec3(-1.3f, 1.0f,-1.5f)  }
     };
 
 
+    // The instance data changes every frame as the cubes spin, so it is
+    // streamed into a buffer hooked up to the cube's vertex array.
+    auto instances = std::vector<Instance>(cubes.size());
+
+    GLuint instanceBuffer;
+    glGenBuffers(1, &instanceBuffer);
+    glBindVertexArray(cubeMeshId);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance), nullptr, GL_STREAM_DRAW);
+
+    auto instanceStride = sizeof(Instance);
+    for (GLuint i = 0; i < 4; i++) {
+        auto offset = (GLvoid*)(offsetof(Instance, model) + i * sizeof(glm::vec4));
+        glVertexAttribPointer(2 + i, 4, GL_FLOAT, GL_FALSE, instanceStride, offset);
+        glEnableVertexAttribArray(2 + i);
+        glVertexAttribDivisor(2 + i, 1);
+    }
+    for (GLuint i = 0; i < 3; i++) {
+        auto offset = (GLvoid*)(offsetof(Instance, normal) + i * sizeof(glm::vec3));
+        glVertexAttribPointer(6 + i, 3, GL_FLOAT, GL_FALSE, instanceStride, offset);
+        glEnableVertexAttribArray(6 + i);
+        glVertexAttribDivisor(6 + i, 1);
+    }
+    auto materialOff = (GLvoid*)(offsetof(Instance, material));
+    glVertexAttribIPointer(9, 1, GL_INT, instanceStride, materialOff);
+    glEnableVertexAttribArray(9);
+    glVertexAttribDivisor(9, 1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+
     /*
      __  __          _____ _   _   _      ____   ____  _____
     |  \/  |   /\   |_   _| \ | | | |    / __ \ / __ \|  __ \
@@ -299,18 +376,12 @@ int main(int argc, char const *argv[])
         glUseProgram(objectShader);
 
         {
-            auto matKaId = glGetUniformLocation(objectShader, "Material.ka");
-            auto matKdId = glGetUniformLocation(objectShader, "Material.kd");
-            auto matKsId = glGetUniformLocation(objectShader, "Material.ks");
-            auto matShineId = glGetUniformLocation(objectShader, "Material.a");
             auto lightKaId = glGetUniformLocation(objectShader, "Light.ka");
             auto lightKdId = glGetUniformLocation(objectShader, "Light.kd");
             auto lightKsId = glGetUniformLocation(objectShader, "Light.ks");
             auto lightPosId = glGetUniformLocation(objectShader, "Light.position");
-            auto modelId = glGetUniformLocation(objectShader, "Model");
             auto viewId  = glGetUniformLocation(objectShader, "View");
             auto projectionId = glGetUniformLocation(objectShader, "Projection");
-            auto normalMatId  = glGetUniformLocation(objectShader, "Normal");
             auto cameraPosId  = glGetUniformLocation(objectShader, "CameraPosition");
             auto cameraPos = camera.getPosition();
             glUniform3f(lightPosId, light.pos.x, light.pos.y, light.pos.z);
@@ -318,34 +389,34 @@ int main(int argc, char const *argv[])
             glUniform3f(lightKdId, light.kd.r, light.kd.g, light.kd.b);
             glUniform3f(lightKsId, 1.0f, 1.0f, 1.0f);
 
+            glUniformMatrix4fv(viewId, 1, GL_FALSE, glm::value_ptr(view));
+            glUniformMatrix4fv(projectionId, 1, GL_FALSE, glm::value_ptr(projection));
+            glUniform3f(cameraPosId, cameraPos.x, cameraPos.y, cameraPos.z);
 
-            for (auto cube : cubes) {
-                auto material = cube.material;
-                auto position = cube.position;
+
+            for (size_t i = 0; i < cubes.size(); i++) {
                 auto model = glm::mat4(1.0f);
                 auto modelRotationAngle = glm::radians(newTime * -55.0f);
                 auto modelRotationAxis = glm::vec3(1.0f, 0.3f, 0.5f);
-                model = glm::translate(model, position);
+                model = glm::translate(model, cubes[i].position);
                 model = glm::rotate(model, modelRotationAngle, modelRotationAxis);
-                auto normalMat = glm::mat3(glm::transpose(glm::inverse(model)));
-
-                glUniformMatrix4fv(modelId, 1, GL_FALSE, glm::value_ptr(model));
-                glUniformMatrix4fv(viewId, 1, GL_FALSE, glm::value_ptr(view));
-                glUniformMatrix4fv(projectionId, 1, GL_FALSE, glm::value_ptr(projection));
-                glUniformMatrix3fv(normalMatId, 1, GL_FALSE, glm::value_ptr(normalMat));
-                glUniform3f(cameraPosId, cameraPos.x, cameraPos.y, cameraPos.z);
 
+                instances[i].model = model;
+                instances[i].normal = glm::mat3(glm::transpose(glm::inverse(model)));
+                instances[i].material = cubes[i].material;
+            }
 
-                glUniform3f(matKaId, material.ka.r, material.ka.g, material.ka.b);
-                glUniform3f(matKdId, material.kd.r, material.kd.g, material.kd.b);
-                glUniform3f(matKsId, material.ks.r, material.ks.g, material.ks.b);
-                glUniform1f(matShineId, material.sh);
+            // Orphan last frame's data rather than waiting for it to be drawn.
+            auto instanceSize = instances.size() * sizeof(Instance);
+            glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+            glBufferData(GL_ARRAY_BUFFER, instanceSize, nullptr, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, instanceSize, instances.data());
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 
-                glBindVertexArray(cubeMeshId);
-                glDrawArrays(GL_TRIANGLES, 0, VERTICES.size());
-                glBindVertexArray(0);
-            }
+            glBindVertexArray(cubeMeshId);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, VERTICES.size() / 6, cubes.size());
+            glBindVertexArray(0);
         }
 
         glUseProgram(lampShader);
@@ -364,7 +435,7 @@ int main(int argc, char const *argv[])
             glUniformMatrix4fv(projectionId, 1, GL_FALSE, glm::value_ptr(projection));
 
             glBindVertexArray(cubeMeshId);
-            glDrawArrays(GL_TRIANGLES, 0, VERTICES.size());
+            glDrawArrays(GL_TRIANGLES, 0, VERTICES.size() / 6);
             glBindVertexArray(0);
         }
 
@@ -375,6 +446,8 @@ int main(int argc, char const *argv[])
 
 
     // CLEANUP
+    glDeleteBuffers(1, &instanceBuffer);
+    glDeleteBuffers(1, &paletteBuffer);
     glDeleteProgram(objectShader);
     glDeleteProgram(lampShader);
     glfwTerminate();
@@ -0,0 +1,99 @@
+#include "blocks.hpp"
+#include "state.hpp"
+
+#include <cstddef>
+
+namespace {
+    struct BlockName
+    {
+        const char* name;
+        glc::BlockBinding binding;
+    };
+
+    const BlockName BLOCK_NAMES[] = {
+        {"Frame",  glc::BlockBinding::FRAME  },
+        {"Lights", glc::BlockBinding::LIGHTS }
+    };
+
+    struct StorageName
+    {
+        const char* name;
+        glc::StorageBinding binding;
+    };
+
+    const StorageName STORAGE_NAMES[] = {
+        {"Draws", glc::StorageBinding::DRAWS }
+    };
+
+    static_assert(sizeof(glm::vec3) == 12 && sizeof(glm::mat4) == 64,
+                  "std140 mirrors assume tightly packed glm types");
+    static_assert(offsetof(glc::FrameBlock, cameraPosition) == 128 &&
+                  sizeof(glc::FrameBlock) == 144, "FrameBlock drifted from std140");
+    static_assert(sizeof(glc::SpotLightBlock) == 80, "SpotLightBlock drifted from std140");
+    static_assert(sizeof(glc::PointLightBlock) == 64, "PointLightBlock drifted from std140");
+    static_assert(sizeof(glc::DirLightBlock) == 64, "DirLightBlock drifted from std140");
+    static_assert(offsetof(glc::LightsBlock, points) == 80 &&
+                  offsetof(glc::LightsBlock, dir) == 80 + 64 * glc::MAX_POINT_LIGHTS &&
+                  sizeof(glc::LightsBlock) == 144 + 64 * glc::MAX_POINT_LIGHTS,
+                  "LightsBlock drifted from std140");
+    static_assert(offsetof(glc::DrawBlock, offset) == 128 &&
+                  offsetof(glc::DrawBlock, layers) == 160 &&
+                  sizeof(glc::DrawBlock) == 176, "DrawBlock drifted from std430");
+}
+
+glc::UniformBuffer::UniformBuffer(glc::BlockBinding binding, GLsizeiptr size)
+: mHandle(0),
+  mBinding(static_cast<GLuint>(binding)),
+  mSize(size)
+{
+    auto& state = glc::StateCache::getDefault();
+    glGenBuffers(1, &mHandle);
+    state.bindBuffer(GL_UNIFORM_BUFFER, mHandle);
+    glBufferData(GL_UNIFORM_BUFFER, mSize, nullptr, GL_DYNAMIC_DRAW);
+    state.bindBufferBase(GL_UNIFORM_BUFFER, mBinding, mHandle);
+}
+
+glc::UniformBuffer::UniformBuffer(glc::UniformBuffer&& other) noexcept
+: mHandle(other.mHandle),
+  mBinding(other.mBinding),
+  mSize(other.mSize)
+{
+    other.mHandle = 0;
+}
+
+glc::UniformBuffer::~UniformBuffer()
+{
+    glc::StateCache::getDefault().deleteBuffers(1, &mHandle);
+}
+
+void glc::UniformBuffer::update(const void* data)
+{
+    glc::StateCache::getDefault().bindBuffer(GL_UNIFORM_BUFFER, mHandle);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, mSize, data);
+}
+
+void glc::bindUniformBlocks(GLuint program)
+{
+    for (const auto& block : ::BLOCK_NAMES)
+    {
+        auto index = glGetUniformBlockIndex(program, block.name);
+        if (index != GL_INVALID_INDEX)
+        {
+            glUniformBlockBinding(program, index, static_cast<GLuint>(block.binding));
+        }
+    }
+
+    if (! GLEW_VERSION_4_3 && ! GLEW_ARB_shader_storage_buffer_object)
+    {
+        return;
+    }
+
+    for (const auto& block : ::STORAGE_NAMES)
+    {
+        auto index = glGetProgramResourceIndex(program, GL_SHADER_STORAGE_BLOCK, block.name);
+        if (index != GL_INVALID_INDEX)
+        {
+            glShaderStorageBlockBinding(program, index, static_cast<GLuint>(block.binding));
+        }
+    }
+}
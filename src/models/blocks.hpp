@@ -0,0 +1,129 @@
+#pragma once
+
+#ifndef GLC_BLOCKS_HPP
+#define GLC_BLOCKS_HPP
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+namespace glc {
+    // Fixed binding points; every program declaring a block of the matching
+    // name is attached to it when built, so one buffer feeds them all.
+    enum class BlockBinding : GLuint
+    {
+        FRAME  = 0,
+        LIGHTS = 1
+    };
+
+    // Shader storage blocks have binding points of their own.
+    enum class StorageBinding : GLuint
+    {
+        DRAWS = 0
+    };
+
+    // Size of the point light array in the Lights block; variants only
+    // evaluate the first NUM_POINT_LIGHTS of them.
+    const int MAX_POINT_LIGHTS = 4;
+
+    // The mirrors below follow std140: vec3s take 16 bytes unless a float
+    // fills the gap, and every struct rounds up to a multiple of 16. Keep
+    // them in step with the block declarations in the shaders.
+
+    // uniform Frame
+    struct FrameBlock
+    {
+        glm::mat4 view;
+        glm::mat4 projection;
+        glm::vec3 cameraPosition;
+        GLfloat pad0;
+    };
+
+    // struct slight
+    struct SpotLightBlock
+    {
+        glm::vec3 position;
+        GLfloat cutOffAngle;
+        glm::vec3 spotDir;
+        GLfloat cutInAngle;
+        glm::vec3 ka;
+        GLfloat pad0;
+        glm::vec3 kd;
+        GLfloat pad1;
+        glm::vec3 ks;
+        GLfloat pad2;
+    };
+
+    // struct plight
+    struct PointLightBlock
+    {
+        glm::vec3 position;
+        GLfloat kc;
+        glm::vec3 ka;
+        GLfloat kl;
+        glm::vec3 kd;
+        GLfloat kq;
+        glm::vec3 ks;
+        GLfloat pad0;
+    };
+
+    // struct dlight
+    struct DirLightBlock
+    {
+        glm::vec3 direction;
+        GLfloat pad0;
+        glm::vec3 ka;
+        GLfloat pad1;
+        glm::vec3 kd;
+        GLfloat pad2;
+        glm::vec3 ks;
+        GLfloat pad3;
+    };
+
+    // uniform Lights
+    struct LightsBlock
+    {
+        glc::SpotLightBlock spot;
+        glc::PointLightBlock points[glc::MAX_POINT_LIGHTS];
+        glc::DirLightBlock dir;
+    };
+
+    // buffer Draws, one entry per draw of a glc::MeshBatch. Laid out std430,
+    // which only differs from std140 for arrays and structs of scalars.
+    struct DrawBlock
+    {
+        glm::mat4 world;
+        // Upper 3x3 only; a mat3 would still take three padded columns.
+        glm::mat4 normal;
+        // xyz as in the VertexOffset and VertexScale uniforms.
+        glm::vec4 offset;
+        glm::vec4 scale;
+        // Diffuse and specular array layers; zw unused.
+        glm::ivec4 layers;
+    };
+
+    // One uniform buffer, attached to its binding point for its lifetime.
+    class UniformBuffer
+    {
+    public:
+        UniformBuffer(glc::BlockBinding binding, GLsizeiptr size);
+        ~UniformBuffer();
+
+        UniformBuffer(const UniformBuffer&) = delete;
+        UniformBuffer& operator=(const UniformBuffer&) = delete;
+        UniformBuffer(UniformBuffer&& other) noexcept;
+
+        // Replaces the whole contents; data must hold the size given above.
+        void update(const void* data);
+    private:
+        GLuint mHandle;
+        GLuint mBinding;
+        GLsizeiptr mSize;
+    };
+
+    // Attaches the program's blocks, storage blocks included where GL has
+    // them, to their binding points. Needed after every link or binary
+    // load, as neither keeps earlier assignments.
+    void bindUniformBlocks(GLuint program);
+}
+
+#endif
@@ -0,0 +1,84 @@
+#include "buffer.hpp"
+#include "state.hpp"
+
+glc::Buffer::Buffer()
+: mHandle(0),
+  mSize(0),
+  mCapacity(0)
+{
+}
+
+glc::Buffer::~Buffer()
+{
+    this->release();
+}
+
+glc::Buffer::Buffer(glc::Buffer&& other) noexcept
+: mHandle(other.mHandle),
+  mSize(other.mSize),
+  mCapacity(other.mCapacity)
+{
+    other.mHandle = 0;
+    other.mSize = 0;
+    other.mCapacity = 0;
+}
+
+glc::Buffer& glc::Buffer::operator=(glc::Buffer&& other) noexcept
+{
+    if (this != &other)
+    {
+        this->release();
+
+        mHandle = other.mHandle;
+        mSize = other.mSize;
+        mCapacity = other.mCapacity;
+        other.mHandle = 0;
+        other.mSize = 0;
+        other.mCapacity = 0;
+    }
+
+    return *this;
+}
+
+void glc::Buffer::upload(GLenum target, const void* data, GLsizeiptr size, GLenum usage)
+{
+    if (! mHandle)
+    {
+        glGenBuffers(1, &mHandle);
+    }
+
+    glc::StateCache::getDefault().bindBuffer(target, mHandle);
+    if (size > mCapacity)
+    {
+        glBufferData(target, size, data, usage);
+        mCapacity = size;
+    }
+    else
+    {
+        glBufferData(target, mCapacity, nullptr, usage);
+        if (data)
+        {
+            glBufferSubData(target, 0, size, data);
+        }
+    }
+    mSize = size;
+}
+
+GLuint glc::Buffer::getHandle() const
+{
+    return mHandle;
+}
+
+GLsizeiptr glc::Buffer::getSize() const
+{
+    return mSize;
+}
+
+void glc::Buffer::release()
+{
+    // Deleting the name 0 is a no-op, so moved-from buffers are safe.
+    glc::StateCache::getDefault().deleteBuffers(1, &mHandle);
+    mHandle = 0;
+    mSize = 0;
+    mCapacity = 0;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#ifndef GLC_BUFFER_HPP
+#define GLC_BUFFER_HPP
+
+#include <GL/glew.h>
+
+namespace glc {
+    // Owns one GL buffer object, created on the first upload. Binds go
+    // through glc::StateCache.
+    class Buffer
+    {
+    public:
+        Buffer();
+        ~Buffer();
+
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+        Buffer(Buffer&& other) noexcept;
+        Buffer& operator=(Buffer&& other) noexcept;
+
+        // Replaces the contents, leaving the buffer bound to target. The
+        // old storage is orphaned rather than overwritten, so draws still
+        // reading it never stall the upload; it only grows. A null data
+        // leaves the contents undefined, as with glBufferData.
+        void upload(GLenum target, const void* data, GLsizeiptr size,
+                    GLenum usage = GL_STREAM_DRAW);
+        GLuint getHandle() const;
+        GLsizeiptr getSize() const;
+    private:
+        GLuint mHandle;
+        GLsizeiptr mSize;
+        GLsizeiptr mCapacity;
+
+        // Helper Methods
+        void release();
+    };
+}
+
+#endif
@@ -0,0 +1,516 @@
+#include "cache.hpp"
+#include "common.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <utility>
+
+namespace {
+    // Bump whenever the on-disk layout or the meaning of its contents changes.
+    const uint32_t CACHE_VERSION = 4;
+    const char CACHE_MAGIC[4] = {'G', 'L', 'C', 'M'};
+
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t options;
+        uint64_t sourceSize;
+        int64_t sourceMtime;
+        uint64_t sourceHash;
+        uint64_t nodeOffset;
+        uint64_t instanceOffset;
+        uint64_t dependencyOffset;
+        uint32_t numMeshes;
+        uint32_t numNodes;
+        uint32_t numInstances;
+        uint32_t numDependencies;
+    };
+
+    struct MeshEntry
+    {
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+        uint64_t textureOffset;
+        uint32_t numVertices;
+        uint32_t numIndices;
+        uint32_t numTextures;
+        uint32_t reserved;
+    };
+
+    struct TexEntry
+    {
+        uint32_t type;
+        uint32_t pathLength;
+    };
+
+    // Followed by nameLength bytes of name, padded to the entry alignment.
+    struct NodeEntry
+    {
+        int32_t parent;
+        uint32_t nameLength;
+        float local[16];
+    };
+
+    struct InstanceEntry
+    {
+        uint32_t mesh;
+        uint32_t node;
+    };
+
+    // Followed by pathLength bytes of path, padded to the entry alignment.
+    struct DependencyEntry
+    {
+        uint64_t size;
+        int64_t mtime;
+        uint64_t hash;
+        uint32_t pathLength;
+        uint32_t reserved;
+    };
+
+    // Offset into the cache file of a stored mtime, and its new value.
+    typedef std::pair<uint64_t, int64_t> MtimePatch;
+
+    uint64_t alignTo(uint64_t offset, uint64_t alignment);
+    void writeMtimes(const std::string& path, const std::vector<MtimePatch>& patches);
+}
+
+glc::MeshCache::MeshCache(std::string sourcePath, uint64_t options)
+: mSourcePath(sourcePath),
+  mCachePath(sourcePath + ".glcache"),
+  mOptions(options),
+  mMapping(nullptr),
+  mMappingSize(0),
+  mMeshes(),
+  mNodes(),
+  mInstances()
+{
+
+}
+
+glc::MeshCache::~MeshCache()
+{
+    this->unmap();
+}
+
+bool glc::MeshCache::load()
+{
+    this->unmap();
+
+    uint64_t sourceSize = 0;
+    int64_t sourceMtime = 0;
+    if (! glc::statFile(mSourcePath, sourceSize, sourceMtime))
+    {
+        return false;
+    }
+
+    auto fd = open(mCachePath.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == -1 || info.st_size < (off_t) sizeof(Header))
+    {
+        close(fd);
+        return false;
+    }
+
+    mMappingSize = info.st_size;
+    mMapping = mmap(nullptr, mMappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mMapping == MAP_FAILED)
+    {
+        mMapping = nullptr;
+        mMappingSize = 0;
+        return false;
+    }
+
+    auto base = static_cast<const char*>(mMapping);
+    auto header = reinterpret_cast<const Header*>(base);
+
+    auto valid = std::memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0
+        && header->version == CACHE_VERSION
+        && header->options == mOptions
+        && header->sourceSize == sourceSize;
+
+    // A touched but otherwise identical input keeps its cache, and gets its
+    // new mtime written back so the next load can skip the hash.
+    auto patches = std::vector<MtimePatch>();
+    if (valid && header->sourceMtime != sourceMtime)
+    {
+        valid = header->sourceHash == glc::hashFile(mSourcePath);
+        patches.emplace_back(offsetof(Header, sourceMtime), sourceMtime);
+    }
+
+    auto entriesEnd = sizeof(Header) + uint64_t(header->numMeshes) * sizeof(MeshEntry);
+    if (! valid || entriesEnd > mMappingSize)
+    {
+        this->unmap();
+        return false;
+    }
+
+    auto dependencyOffset = header->dependencyOffset;
+    for (size_t i = 0; i < header->numDependencies; i++)
+    {
+        if (dependencyOffset + sizeof(DependencyEntry) > mMappingSize)
+        {
+            this->unmap();
+            return false;
+        }
+
+        auto dependency = reinterpret_cast<const DependencyEntry*>(base + dependencyOffset);
+        auto pathOffset = dependencyOffset + sizeof(DependencyEntry);
+        if (pathOffset + dependency->pathLength > mMappingSize)
+        {
+            this->unmap();
+            return false;
+        }
+
+        auto path = std::string(base + pathOffset, dependency->pathLength);
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        if (! glc::statFile(path, size, mtime) || size != dependency->size
+            || (mtime != dependency->mtime && glc::hashFile(path) != dependency->hash))
+        {
+            this->unmap();
+            return false;
+        }
+
+        if (mtime != dependency->mtime)
+        {
+            patches.emplace_back(dependencyOffset + offsetof(DependencyEntry, mtime), mtime);
+        }
+        dependencyOffset = ::alignTo(pathOffset + dependency->pathLength, alignof(DependencyEntry));
+    }
+
+    auto entries = reinterpret_cast<const MeshEntry*>(base + sizeof(Header));
+    for (size_t i = 0; i < header->numMeshes; i++)
+    {
+        const auto& e = entries[i];
+
+        auto vertexEnd = e.vertexOffset + uint64_t(e.numVertices) * sizeof(glc::Vex);
+        auto indexEnd = e.indexOffset + uint64_t(e.numIndices) * sizeof(GLuint);
+        if (vertexEnd > mMappingSize || indexEnd > mMappingSize)
+        {
+            this->unmap();
+            return false;
+        }
+
+        auto view = glc::MeshView();
+        view.vertices = reinterpret_cast<const glc::Vex*>(base + e.vertexOffset);
+        view.numVertices = e.numVertices;
+        view.indices = reinterpret_cast<const GLuint*>(base + e.indexOffset);
+        view.numIndices = e.numIndices;
+
+        auto offset = e.textureOffset;
+        for (size_t j = 0; j < e.numTextures; j++)
+        {
+            if (offset + sizeof(TexEntry) > mMappingSize)
+            {
+                this->unmap();
+                return false;
+            }
+
+            auto tex = reinterpret_cast<const TexEntry*>(base + offset);
+            offset += sizeof(TexEntry);
+
+            if (offset + tex->pathLength > mMappingSize)
+            {
+                this->unmap();
+                return false;
+            }
+
+            auto ref = glc::TexRef();
+            ref.path = std::string(base + offset, tex->pathLength);
+            ref.type = static_cast<glc::TexType>(tex->type);
+            view.textures.emplace_back(ref);
+            offset = ::alignTo(offset + tex->pathLength, alignof(TexEntry));
+        }
+
+        mMeshes.emplace_back(view);
+    }
+
+    auto offset = header->nodeOffset;
+    for (size_t i = 0; i < header->numNodes; i++)
+    {
+        if (offset + sizeof(NodeEntry) > mMappingSize)
+        {
+            this->unmap();
+            return false;
+        }
+
+        auto node = reinterpret_cast<const NodeEntry*>(base + offset);
+        offset += sizeof(NodeEntry);
+
+        if (offset + node->nameLength > mMappingSize
+            || node->parent < glc::TransformGraph::NO_PARENT || node->parent >= int32_t(i))
+        {
+            this->unmap();
+            return false;
+        }
+
+        auto local = glm::mat4(1.0f);
+        std::memcpy(&local[0][0], node->local, sizeof(NodeEntry::local));
+        mNodes.addNode(node->parent, local, std::string(base + offset, node->nameLength));
+        offset = ::alignTo(offset + node->nameLength, alignof(NodeEntry));
+    }
+
+    auto instanceEnd = header->instanceOffset + uint64_t(header->numInstances) * sizeof(InstanceEntry);
+    if (instanceEnd > mMappingSize)
+    {
+        this->unmap();
+        return false;
+    }
+
+    auto instances = reinterpret_cast<const InstanceEntry*>(base + header->instanceOffset);
+    for (size_t i = 0; i < header->numInstances; i++)
+    {
+        if (instances[i].mesh >= mMeshes.size() || instances[i].node >= mNodes.getSize())
+        {
+            this->unmap();
+            return false;
+        }
+
+        auto instance = glc::MeshInstance();
+        instance.mesh = instances[i].mesh;
+        instance.node = instances[i].node;
+        mInstances.emplace_back(instance);
+    }
+
+    ::writeMtimes(mCachePath, patches);
+    return true;
+}
+
+bool glc::MeshCache::save(
+    const std::vector<glc::MeshData>& meshes,
+    const glc::TransformGraph& nodes,
+    const std::vector<glc::MeshInstance>& instances,
+    const std::vector<std::string>& dependencies)
+{
+    auto header = Header();
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.options = mOptions;
+    header.numMeshes = meshes.size();
+    header.numNodes = nodes.getSize();
+    header.numInstances = instances.size();
+
+    if (! glc::statFile(mSourcePath, header.sourceSize, header.sourceMtime))
+    {
+        return false;
+    }
+
+    header.sourceHash = glc::hashFile(mSourcePath);
+
+    auto depends = std::vector<std::pair<DependencyEntry, std::string>>();
+    for (const auto& path : dependencies)
+    {
+        if (path == mSourcePath)
+        {
+            continue;
+        }
+
+        auto dependency = DependencyEntry();
+        if (! glc::statFile(path, dependency.size, dependency.mtime))
+        {
+            return false;
+        }
+
+        dependency.hash = glc::hashFile(path);
+        dependency.pathLength = path.size();
+        dependency.reserved = 0;
+        depends.emplace_back(dependency, path);
+    }
+    header.numDependencies = depends.size();
+
+    // Lay the payload out after the entry table, keeping every array aligned
+    // so that the mapped pointers can be handed straight to GL.
+    auto entries = std::vector<MeshEntry>(meshes.size());
+    auto offset = uint64_t(sizeof(Header) + entries.size() * sizeof(MeshEntry));
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        auto& e = entries[i];
+        e.numVertices = meshes[i].vertices.size();
+        e.numIndices = meshes[i].indices.size();
+        e.numTextures = meshes[i].textures.size();
+        e.reserved = 0;
+
+        offset = ::alignTo(offset, alignof(glc::Vex));
+        e.vertexOffset = offset;
+        offset += e.numVertices * sizeof(glc::Vex);
+
+        offset = ::alignTo(offset, alignof(GLuint));
+        e.indexOffset = offset;
+        offset += e.numIndices * sizeof(GLuint);
+
+        offset = ::alignTo(offset, alignof(TexEntry));
+        e.textureOffset = offset;
+        for (const auto& t : meshes[i].textures)
+        {
+            offset = ::alignTo(offset + sizeof(TexEntry) + t.path.size(), alignof(TexEntry));
+        }
+    }
+
+    offset = ::alignTo(offset, alignof(NodeEntry));
+    header.nodeOffset = offset;
+    for (size_t i = 0; i < nodes.getSize(); i++)
+    {
+        offset = ::alignTo(offset + sizeof(NodeEntry) + nodes.getName(i).size(), alignof(NodeEntry));
+    }
+
+    offset = ::alignTo(offset, alignof(InstanceEntry));
+    header.instanceOffset = offset;
+    offset += instances.size() * sizeof(InstanceEntry);
+
+    offset = ::alignTo(offset, alignof(DependencyEntry));
+    header.dependencyOffset = offset;
+    for (const auto& d : depends)
+    {
+        offset = ::alignTo(offset + sizeof(DependencyEntry) + d.second.size(), alignof(DependencyEntry));
+    }
+
+    auto buffer = std::vector<char>(offset, 0);
+    std::memcpy(buffer.data(), &header, sizeof(Header));
+    std::memcpy(buffer.data() + sizeof(Header), entries.data(), entries.size() * sizeof(MeshEntry));
+
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        const auto& e = entries[i];
+        const auto& m = meshes[i];
+
+        std::memcpy(buffer.data() + e.vertexOffset, m.vertices.data(), m.vertices.size() * sizeof(glc::Vex));
+        std::memcpy(buffer.data() + e.indexOffset, m.indices.data(), m.indices.size() * sizeof(GLuint));
+
+        auto texOffset = e.textureOffset;
+        for (const auto& t : m.textures)
+        {
+            auto tex = TexEntry();
+            tex.type = static_cast<uint32_t>(t.type);
+            tex.pathLength = t.path.size();
+            std::memcpy(buffer.data() + texOffset, &tex, sizeof(TexEntry));
+            std::memcpy(buffer.data() + texOffset + sizeof(TexEntry), t.path.data(), t.path.size());
+            texOffset = ::alignTo(texOffset + sizeof(TexEntry) + t.path.size(), alignof(TexEntry));
+        }
+    }
+
+    auto nodeOffset = header.nodeOffset;
+    for (size_t i = 0; i < nodes.getSize(); i++)
+    {
+        const auto& name = nodes.getName(i);
+
+        auto node = NodeEntry();
+        node.parent = nodes.getParent(i);
+        node.nameLength = name.size();
+        std::memcpy(node.local, &nodes.getLocal(i)[0][0], sizeof(node.local));
+        std::memcpy(buffer.data() + nodeOffset, &node, sizeof(NodeEntry));
+        std::memcpy(buffer.data() + nodeOffset + sizeof(NodeEntry), name.data(), name.size());
+        nodeOffset = ::alignTo(nodeOffset + sizeof(NodeEntry) + name.size(), alignof(NodeEntry));
+    }
+
+    for (size_t i = 0; i < instances.size(); i++)
+    {
+        auto entry = InstanceEntry();
+        entry.mesh = instances[i].mesh;
+        entry.node = instances[i].node;
+        std::memcpy(buffer.data() + header.instanceOffset + i * sizeof(InstanceEntry), &entry, sizeof(entry));
+    }
+
+    auto dependencyOffset = header.dependencyOffset;
+    for (const auto& d : depends)
+    {
+        std::memcpy(buffer.data() + dependencyOffset, &d.first, sizeof(DependencyEntry));
+        std::memcpy(buffer.data() + dependencyOffset + sizeof(DependencyEntry), d.second.data(), d.second.size());
+        dependencyOffset = ::alignTo(dependencyOffset + sizeof(DependencyEntry) + d.second.size(), alignof(DependencyEntry));
+    }
+
+    // Write to the side and rename so a crash never leaves a torn cache.
+    auto tmpPath = mCachePath + ".tmp";
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    file.write(buffer.data(), buffer.size());
+    file.close();
+
+    if (! file || std::rename(tmpPath.c_str(), mCachePath.c_str()) != 0)
+    {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+const std::vector<glc::MeshView>& glc::MeshCache::getMeshes() const
+{
+    return mMeshes;
+}
+
+const glc::TransformGraph& glc::MeshCache::getNodes() const
+{
+    return mNodes;
+}
+
+const std::vector<glc::MeshInstance>& glc::MeshCache::getInstances() const
+{
+    return mInstances;
+}
+
+std::string glc::MeshCache::getPath() const
+{
+    return mCachePath;
+}
+
+void glc::MeshCache::unmap()
+{
+    mMeshes.clear();
+    mNodes = glc::TransformGraph();
+    mInstances.clear();
+
+    if (mMapping)
+    {
+        munmap(mMapping, mMappingSize);
+        mMapping = nullptr;
+        mMappingSize = 0;
+    }
+}
+
+
+namespace {
+    uint64_t alignTo(uint64_t offset, uint64_t alignment)
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    void writeMtimes(const std::string& path, const std::vector<MtimePatch>& patches)
+    {
+        if (patches.empty())
+        {
+            return;
+        }
+
+        // Best effort: a lost update only costs the next load another hash.
+        auto fd = open(path.c_str(), O_WRONLY);
+        if (fd == -1)
+        {
+            return;
+        }
+
+        for (const auto& p : patches)
+        {
+            if (pwrite(fd, &p.second, sizeof(p.second), p.first) != sizeof(p.second))
+            {
+                break;
+            }
+        }
+
+        close(fd);
+    }
+}
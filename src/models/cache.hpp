@@ -0,0 +1,77 @@
+#pragma once
+
+#ifndef GLC_CACHE_HPP
+#define GLC_CACHE_HPP
+
+#include "model.hpp"
+#include "transform.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace glc {
+    struct TexRef
+    {
+        std::string path;
+        glc::TexType type;
+    };
+
+    // Flattened geometry of a single mesh, as produced by the importer.
+    struct MeshData
+    {
+        std::vector<glc::Vex> vertices;
+        std::vector<GLuint> indices;
+        std::vector<glc::TexRef> textures;
+    };
+
+    // Non-owning view of a single mesh inside a mapped cache file.
+    struct MeshView
+    {
+        const glc::Vex* vertices;
+        size_t numVertices;
+        const GLuint* indices;
+        size_t numIndices;
+        std::vector<glc::TexRef> textures;
+    };
+
+    // Versioned binary cache of everything glc::Model pulls out of Assimp.
+    // The cache lives next to the source file and is invalidated whenever
+    // the source or a dependency the importer read alongside it, such as an
+    // .obj's material library, changes (size, mtime and content hash) or the
+    // caller asks for a different set of import options.
+    class MeshCache
+    {
+    public:
+         MeshCache(std::string sourcePath, uint64_t options);
+        ~MeshCache();
+
+        MeshCache(const MeshCache&) = delete;
+        MeshCache& operator=(const MeshCache&) = delete;
+
+        bool load();
+        bool save(const std::vector<glc::MeshData>& meshes,
+                  const glc::TransformGraph& nodes,
+                  const std::vector<glc::MeshInstance>& instances,
+                  const std::vector<std::string>& dependencies);
+        const std::vector<glc::MeshView>& getMeshes() const;
+        const glc::TransformGraph& getNodes() const;
+        const std::vector<glc::MeshInstance>& getInstances() const;
+        std::string getPath() const;
+    private:
+        std::string mSourcePath;
+        std::string mCachePath;
+        uint64_t mOptions;
+        void* mMapping;
+        size_t mMappingSize;
+        std::vector<glc::MeshView> mMeshes;
+        glc::TransformGraph mNodes;
+        std::vector<glc::MeshInstance> mInstances;
+
+        // Helper Methods
+        void unmap();
+    };
+}
+
+#endif
@@ -1,6 +1,8 @@
 #include "common.hpp"
 #include "error.hpp"
 
+#include <sys/stat.h>
+
 #include <fstream>
 
 std::string glc::makeString(std::string path)
@@ -36,3 +38,39 @@ std::string glc::makeString(std::vector<std::string> strs, std::string delim)
 
     return str;
 }
+
+uint64_t glc::hashString(const std::string& text, uint64_t hash)
+{
+    for (auto c : text)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+uint64_t glc::hashFile(std::string path)
+{
+    return glc::hashString(glc::makeString(path));
+}
+
+bool glc::statFile(std::string path, uint64_t& size, int64_t& mtime)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) == -1)
+    {
+        return false;
+    }
+
+    // Nanosecond precision, so that edits within the same second still
+    // fall through to the content hash.
+#ifdef __APPLE__
+    auto spec = info.st_mtimespec;
+#else
+    auto spec = info.st_mtim;
+#endif
+    size = info.st_size;
+    mtime = int64_t(spec.tv_sec) * 1000000000 + spec.tv_nsec;
+    return true;
+}
@@ -3,12 +3,19 @@
 #ifndef GLC_COMMON_HPP
 #define GLC_COMMON_HPP
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
 namespace glc {
     std::string makeString(std::string path);
     std::string makeString(std::vector<std::string> strs, std::string delim="");
+    // FNV-1a, 64 bit; seed with a previous hash to chain several inputs.
+    uint64_t hashString(const std::string& text, uint64_t hash = 14695981039346656037ull);
+    // hashString() of the file's contents.
+    uint64_t hashFile(std::string path);
+    // Size and modification time in nanoseconds; false if there is no file.
+    bool statFile(std::string path, uint64_t& size, int64_t& mtime);
 }
 
 
@@ -0,0 +1,650 @@
+#include "compress.hpp"
+#include "common.hpp"
+#include "mipmap.hpp"
+#include "pool.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <iterator>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+    // Bump whenever the on-disk layout or the encoders' output changes.
+    const uint32_t CONTAINER_VERSION = 4;
+    const char CONTAINER_MAGIC[4] = {'G', 'L', 'C', 'T'};
+
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t format;
+        uint32_t numLevels;
+        uint64_t sourceSize;
+        int64_t sourceMtime;
+        uint64_t sourceHash;
+    };
+
+    struct LevelEntry
+    {
+        uint32_t width;
+        uint32_t height;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    // One 4x4 block of BGRA texels, row-major.
+    typedef unsigned char Block[16][4];
+
+    size_t getBlockSize(glc::BlockFormat format);
+    void fetchBlock(const glc::Image& image, GLsizei x, GLsizei y, Block& block);
+    void encodeRows(const glc::Image& image, glc::BlockFormat format,
+                    GLsizei firstRow, GLsizei lastRow, unsigned char* out);
+    void encodeColor(const Block& block, unsigned char* out);
+    void encodeChannel(const Block& block, size_t channel, unsigned char* out);
+    void getBounds(const Block& block, unsigned char lo[4], unsigned char hi[4]);
+    uint32_t matchColors(const int rgb[16][3], const int palette[4][3]);
+    uint64_t matchChannel(const Block& block, size_t channel, const int palette[8]);
+    uint16_t packColor(const int rgb[3]);
+    void unpackColor(uint16_t color, int rgb[3]);
+    bool readContainer(std::string path, std::string sourcePath, uint64_t size, int64_t mtime,
+                       glc::CompressedImage& image);
+    bool writeContainer(std::string path, uint64_t size, int64_t mtime, uint64_t hash,
+                        const glc::CompressedImage& image);
+}
+
+glc::BlockFormat glc::chooseBlockFormat(const glc::Image& image)
+{
+    if (image.channels == 1)
+    {
+        return glc::BlockFormat::BC4;
+    }
+
+    if (image.channels == 2)
+    {
+        return glc::BlockFormat::BC5;
+    }
+
+    return image.channels == 3 ? glc::BlockFormat::BC1 : glc::BlockFormat::BC3;
+}
+
+glc::CompressedImage glc::compressImage(
+    const glc::Image& image,
+    glc::BlockFormat format,
+    glc::ThreadPool* pool,
+    bool srgb)
+{
+    auto result = glc::CompressedImage();
+    result.format = format;
+
+    if (image.pixels.empty())
+    {
+        return result;
+    }
+
+    // Containers always hold the full chain; tiers are applied on upload.
+    auto mips = glc::makeMipChain(image, srgb);
+    std::vector<const glc::Image*> levels;
+    for (const auto& m : mips)
+    {
+        levels.emplace_back(&m);
+    }
+
+    auto offset = size_t(0);
+    for (const auto* l : levels)
+    {
+        auto level = glc::MipLevel();
+        level.width = l->width;
+        level.height = l->height;
+        level.offset = offset;
+        level.size = size_t((l->width + 3) / 4) * ((l->height + 3) / 4) * ::getBlockSize(format);
+        result.levels.emplace_back(level);
+        offset += level.size;
+    }
+
+    result.data.resize(offset);
+
+    if (! pool)
+    {
+        for (size_t i = 0; i < levels.size(); i++)
+        {
+            auto rows = (levels[i]->height + 3) / 4;
+            ::encodeRows(*levels[i], format, 0, rows, result.data.data() + result.levels[i].offset);
+        }
+
+        return result;
+    }
+
+    // Split every level into bands of block rows; small mips stay whole.
+    const auto BAND_ROWS = GLsizei(16);
+    std::vector<std::future<void>> jobs;
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        const auto* level = levels[i];
+        auto rows = (level->height + 3) / 4;
+        auto rowSize = size_t((level->width + 3) / 4) * ::getBlockSize(format);
+        auto* out = result.data.data() + result.levels[i].offset;
+
+        for (GLsizei first = 0; first < rows; first += BAND_ROWS)
+        {
+            auto last = std::min(first + BAND_ROWS, rows);
+            auto* band = out + first * rowSize;
+            jobs.emplace_back(pool->submit([level, format, first, last, band]() {
+                ::encodeRows(*level, format, first, last, band);
+            }));
+        }
+    }
+
+    for (auto& j : jobs)
+    {
+        j.get();
+    }
+
+    return result;
+}
+
+glc::CompressedImage glc::loadCompressedImage(std::string path, glc::ThreadPool* pool, bool srgb)
+{
+    auto containerPath = path + (srgb ? ".glctex" : ".linear.glctex");
+
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    if (! glc::statFile(path, size, mtime))
+    {
+        return glc::CompressedImage();
+    }
+
+    auto image = glc::CompressedImage();
+    if (::readContainer(containerPath, path, size, mtime, image))
+    {
+        return image;
+    }
+
+    auto decoded = glc::decodeImage(path);
+    image = glc::compressImage(decoded, glc::chooseBlockFormat(decoded), pool, srgb);
+
+    auto hash = glc::hashFile(path);
+    if (! image.levels.empty() && ! ::writeContainer(containerPath, size, mtime, hash, image))
+    {
+        std::cout << "Failed to write texture container: " << containerPath << "\n";
+    }
+
+    return image;
+}
+
+
+namespace {
+    size_t getBlockSize(glc::BlockFormat format)
+    {
+        auto small = format == glc::BlockFormat::BC1 || format == glc::BlockFormat::BC4;
+        return small ? 8 : 16;
+    }
+
+    void fetchBlock(const glc::Image& image, GLsizei x, GLsizei y, Block& block)
+    {
+        // Texels past the edge repeat the last row or column.
+        for (GLsizei j = 0; j < 4; j++)
+        {
+            auto py = std::min(y + j, image.height - 1);
+            for (GLsizei i = 0; i < 4; i++)
+            {
+                auto px = std::min(x + i, image.width - 1);
+                const auto* texel = image.pixels.data() + (size_t(py) * image.width + px) * 4;
+                std::memcpy(block[j * 4 + i], texel, 4);
+            }
+        }
+    }
+
+    void encodeRows(const glc::Image& image, glc::BlockFormat format,
+                    GLsizei firstRow, GLsizei lastRow, unsigned char* out)
+    {
+        auto blockSize = getBlockSize(format);
+        auto columns = (image.width + 3) / 4;
+
+        Block block;
+        for (GLsizei row = firstRow; row < lastRow; row++)
+        {
+            for (GLsizei column = 0; column < columns; column++)
+            {
+                fetchBlock(image, column * 4, row * 4, block);
+
+                // Image pixels are BGRA.
+                switch (format)
+                {
+                case glc::BlockFormat::BC1:
+                    encodeColor(block, out);
+                    break;
+                case glc::BlockFormat::BC3:
+                    encodeChannel(block, 3, out);
+                    encodeColor(block, out + 8);
+                    break;
+                case glc::BlockFormat::BC4:
+                    encodeChannel(block, 2, out);
+                    break;
+                case glc::BlockFormat::BC5:
+                    encodeChannel(block, 2, out);
+                    encodeChannel(block, 3, out + 8);
+                    break;
+                }
+
+                out += blockSize;
+            }
+        }
+    }
+
+    void encodeColor(const Block& block, unsigned char* out)
+    {
+        // Endpoints from the bounding box, flipped onto the diagonal that
+        // follows the block's dominant correlation, then inset slightly.
+        unsigned char bgraLo[4];
+        unsigned char bgraHi[4];
+        getBounds(block, bgraLo, bgraHi);
+        int lo[3] = {bgraLo[2], bgraLo[1], bgraLo[0]};
+        int hi[3] = {bgraHi[2], bgraHi[1], bgraHi[0]};
+
+        int rgb[16][3];
+        int mean[3] = {0, 0, 0};
+        for (size_t i = 0; i < 16; i++)
+        {
+            rgb[i][0] = block[i][2];
+            rgb[i][1] = block[i][1];
+            rgb[i][2] = block[i][0];
+            for (size_t c = 0; c < 3; c++)
+            {
+                mean[c] += rgb[i][c];
+            }
+        }
+
+        int cov[3] = {0, 0, 0};
+        for (size_t i = 0; i < 16; i++)
+        {
+            auto r = rgb[i][0] * 16 - mean[0];
+            cov[1] += r * (rgb[i][1] * 16 - mean[1]);
+            cov[2] += r * (rgb[i][2] * 16 - mean[2]);
+        }
+
+        for (size_t c = 1; c < 3; c++)
+        {
+            if (cov[c] < 0)
+            {
+                std::swap(lo[c], hi[c]);
+            }
+        }
+
+        for (size_t c = 0; c < 3; c++)
+        {
+            auto inset = (hi[c] - lo[c]) / 16;
+            hi[c] -= inset;
+            lo[c] += inset;
+        }
+
+        auto c0 = packColor(hi);
+        auto c1 = packColor(lo);
+        if (c0 < c1)
+        {
+            std::swap(c0, c1);
+        }
+
+        int palette[4][3];
+        unpackColor(c0, palette[0]);
+        unpackColor(c1, palette[1]);
+        for (size_t c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        auto indices = c0 != c1 ? matchColors(rgb, palette) : uint32_t(0);
+
+        out[0] = c0 & 0xFF;
+        out[1] = c0 >> 8;
+        out[2] = c1 & 0xFF;
+        out[3] = c1 >> 8;
+        for (size_t i = 0; i < 4; i++)
+        {
+            out[4 + i] = (indices >> (i * 8)) & 0xFF;
+        }
+    }
+
+    void encodeChannel(const Block& block, size_t channel, unsigned char* out)
+    {
+        // BC4: two endpoints and eight interpolated steps between them.
+        unsigned char bgraLo[4];
+        unsigned char bgraHi[4];
+        getBounds(block, bgraLo, bgraHi);
+        int lo = bgraLo[channel];
+        int hi = bgraHi[channel];
+
+        out[0] = static_cast<unsigned char>(hi);
+        out[1] = static_cast<unsigned char>(lo);
+
+        int palette[8];
+        palette[0] = hi;
+        palette[1] = lo;
+        for (int k = 1; k < 7; k++)
+        {
+            palette[k + 1] = ((7 - k) * hi + k * lo) / 7;
+        }
+
+        auto indices = hi != lo ? matchChannel(block, channel, palette) : uint64_t(0);
+
+        for (size_t i = 0; i < 6; i++)
+        {
+            out[2 + i] = (indices >> (i * 8)) & 0xFF;
+        }
+    }
+
+    void getBounds(const Block& block, unsigned char lo[4], unsigned char hi[4])
+    {
+        // Per channel minimum and maximum over the block's 16 texels.
+#if defined(__AVX2__)
+        auto first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block[0]));
+        auto second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block[8]));
+        auto min8 = _mm256_min_epu8(first, second);
+        auto max8 = _mm256_max_epu8(first, second);
+        auto min4 = _mm_min_epu8(_mm256_castsi256_si128(min8), _mm256_extracti128_si256(min8, 1));
+        auto max4 = _mm_max_epu8(_mm256_castsi256_si128(max8), _mm256_extracti128_si256(max8, 1));
+#elif defined(__SSE2__)
+        __m128i rows[4];
+        for (size_t j = 0; j < 4; j++)
+        {
+            rows[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block[j * 4]));
+        }
+        auto min4 = _mm_min_epu8(_mm_min_epu8(rows[0], rows[1]), _mm_min_epu8(rows[2], rows[3]));
+        auto max4 = _mm_max_epu8(_mm_max_epu8(rows[0], rows[1]), _mm_max_epu8(rows[2], rows[3]));
+#endif
+
+#if defined(__AVX2__) || defined(__SSE2__)
+        // Fold the four texels left in each register into the lowest one.
+        min4 = _mm_min_epu8(min4, _mm_srli_si128(min4, 8));
+        min4 = _mm_min_epu8(min4, _mm_srli_si128(min4, 4));
+        max4 = _mm_max_epu8(max4, _mm_srli_si128(max4, 8));
+        max4 = _mm_max_epu8(max4, _mm_srli_si128(max4, 4));
+
+        auto loBytes = _mm_cvtsi128_si32(min4);
+        auto hiBytes = _mm_cvtsi128_si32(max4);
+        std::memcpy(lo, &loBytes, 4);
+        std::memcpy(hi, &hiBytes, 4);
+#else
+        std::memcpy(lo, block[0], 4);
+        std::memcpy(hi, block[0], 4);
+        for (size_t i = 1; i < 16; i++)
+        {
+            for (size_t c = 0; c < 4; c++)
+            {
+                lo[c] = std::min(lo[c], block[i][c]);
+                hi[c] = std::max(hi[c], block[i][c]);
+            }
+        }
+#endif
+    }
+
+    uint32_t matchColors(const int rgb[16][3], const int palette[4][3])
+    {
+        // Nearest palette entry per texel by squared distance, ties going to
+        // the lower entry. The SIMD paths put the entry in the low bits of
+        // the error, which a float holds exactly, and keep the minimum.
+        auto indices = uint32_t(0);
+#if defined(__AVX2__) || defined(__SSE2__)
+        auto entries = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+        auto pr = _mm_setr_ps(float(palette[0][0]), float(palette[1][0]), float(palette[2][0]), float(palette[3][0]));
+        auto pg = _mm_setr_ps(float(palette[0][1]), float(palette[1][1]), float(palette[2][1]), float(palette[3][1]));
+        auto pb = _mm_setr_ps(float(palette[0][2]), float(palette[1][2]), float(palette[2][2]), float(palette[3][2]));
+#endif
+
+#if defined(__AVX2__)
+        // Two texels at a time, one per 128-bit half.
+        auto entries2 = _mm256_insertf128_ps(_mm256_castps128_ps256(entries), entries, 1);
+        auto pr2 = _mm256_insertf128_ps(_mm256_castps128_ps256(pr), pr, 1);
+        auto pg2 = _mm256_insertf128_ps(_mm256_castps128_ps256(pg), pg, 1);
+        auto pb2 = _mm256_insertf128_ps(_mm256_castps128_ps256(pb), pb, 1);
+        for (size_t i = 0; i < 16; i += 2)
+        {
+            __m256 channels[3];
+            for (size_t c = 0; c < 3; c++)
+            {
+                auto first = _mm256_castps128_ps256(_mm_set1_ps(float(rgb[i][c])));
+                channels[c] = _mm256_insertf128_ps(first, _mm_set1_ps(float(rgb[i + 1][c])), 1);
+            }
+
+            auto dr = _mm256_sub_ps(channels[0], pr2);
+            auto dg = _mm256_sub_ps(channels[1], pg2);
+            auto db = _mm256_sub_ps(channels[2], pb2);
+            auto error = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dr, dr), _mm256_mul_ps(dg, dg)),
+                                       _mm256_mul_ps(db, db));
+            auto key = _mm256_add_ps(_mm256_mul_ps(error, _mm256_set1_ps(4.0f)), entries2);
+            key = _mm256_min_ps(key, _mm256_shuffle_ps(key, key, _MM_SHUFFLE(1, 0, 3, 2)));
+            key = _mm256_min_ps(key, _mm256_shuffle_ps(key, key, _MM_SHUFFLE(2, 3, 0, 1)));
+
+            auto first = uint32_t(_mm_cvtss_f32(_mm256_castps256_ps128(key))) & 3;
+            auto second = uint32_t(_mm_cvtss_f32(_mm256_extractf128_ps(key, 1))) & 3;
+            indices |= first << (i * 2) | second << ((i + 1) * 2);
+        }
+#elif defined(__SSE2__)
+        for (size_t i = 0; i < 16; i++)
+        {
+            auto dr = _mm_sub_ps(_mm_set1_ps(float(rgb[i][0])), pr);
+            auto dg = _mm_sub_ps(_mm_set1_ps(float(rgb[i][1])), pg);
+            auto db = _mm_sub_ps(_mm_set1_ps(float(rgb[i][2])), pb);
+            auto error = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+            auto key = _mm_add_ps(_mm_mul_ps(error, _mm_set1_ps(4.0f)), entries);
+            key = _mm_min_ps(key, _mm_shuffle_ps(key, key, _MM_SHUFFLE(1, 0, 3, 2)));
+            key = _mm_min_ps(key, _mm_shuffle_ps(key, key, _MM_SHUFFLE(2, 3, 0, 1)));
+
+            indices |= (uint32_t(_mm_cvtss_f32(key)) & 3) << (i * 2);
+        }
+#else
+        for (size_t i = 0; i < 16; i++)
+        {
+            auto best = uint32_t(0);
+            auto bestError = INT32_MAX;
+            for (uint32_t p = 0; p < 4; p++)
+            {
+                auto dr = rgb[i][0] - palette[p][0];
+                auto dg = rgb[i][1] - palette[p][1];
+                auto db = rgb[i][2] - palette[p][2];
+                auto error = dr * dr + dg * dg + db * db;
+                if (error < bestError)
+                {
+                    best = p;
+                    bestError = error;
+                }
+            }
+
+            indices |= best << (i * 2);
+        }
+#endif
+
+        return indices;
+    }
+
+    uint64_t matchChannel(const Block& block, size_t channel, const int palette[8])
+    {
+        // Nearest of the eight steps per texel, ties going to the lower one.
+        // As with colours, the SIMD paths keep the step in the low bits.
+        auto indices = uint64_t(0);
+#if defined(__AVX2__) || defined(__SSE2__)
+        auto steps = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+        auto values = _mm_setr_epi16(palette[0], palette[1], palette[2], palette[3],
+                                     palette[4], palette[5], palette[6], palette[7]);
+#endif
+
+#if defined(__AVX2__)
+        // Two texels at a time, one per 128-bit half.
+        auto steps2 = _mm256_broadcastsi128_si256(steps);
+        auto values2 = _mm256_broadcastsi128_si256(values);
+        for (size_t i = 0; i < 16; i += 2)
+        {
+            auto first = _mm256_castsi128_si256(_mm_set1_epi16(block[i][channel]));
+            auto texels = _mm256_inserti128_si256(first, _mm_set1_epi16(block[i + 1][channel]), 1);
+            auto error = _mm256_abs_epi16(_mm256_sub_epi16(texels, values2));
+            auto key = _mm256_or_si256(_mm256_slli_epi16(error, 3), steps2);
+            key = _mm256_min_epi16(key, _mm256_srli_si256(key, 8));
+            key = _mm256_min_epi16(key, _mm256_srli_si256(key, 4));
+            key = _mm256_min_epi16(key, _mm256_srli_si256(key, 2));
+
+            auto low = uint64_t(_mm_cvtsi128_si32(_mm256_castsi256_si128(key)) & 7);
+            auto high = uint64_t(_mm_cvtsi128_si32(_mm256_extracti128_si256(key, 1)) & 7);
+            indices |= low << (i * 3) | high << ((i + 1) * 3);
+        }
+#elif defined(__SSE2__)
+        for (size_t i = 0; i < 16; i++)
+        {
+            auto texel = _mm_set1_epi16(block[i][channel]);
+            auto error = _mm_max_epi16(_mm_sub_epi16(texel, values), _mm_sub_epi16(values, texel));
+            auto key = _mm_or_si128(_mm_slli_epi16(error, 3), steps);
+            key = _mm_min_epi16(key, _mm_srli_si128(key, 8));
+            key = _mm_min_epi16(key, _mm_srli_si128(key, 4));
+            key = _mm_min_epi16(key, _mm_srli_si128(key, 2));
+
+            indices |= uint64_t(_mm_cvtsi128_si32(key) & 7) << (i * 3);
+        }
+#else
+        for (size_t i = 0; i < 16; i++)
+        {
+            auto value = int(block[i][channel]);
+            auto best = uint64_t(0);
+            auto bestError = 256;
+            for (uint64_t p = 0; p < 8; p++)
+            {
+                auto error = std::abs(value - palette[p]);
+                if (error < bestError)
+                {
+                    best = p;
+                    bestError = error;
+                }
+            }
+
+            indices |= best << (i * 3);
+        }
+#endif
+
+        return indices;
+    }
+
+    uint16_t packColor(const int rgb[3])
+    {
+        auto r = (rgb[0] * 31 + 127) / 255;
+        auto g = (rgb[1] * 63 + 127) / 255;
+        auto b = (rgb[2] * 31 + 127) / 255;
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    void unpackColor(uint16_t color, int rgb[3])
+    {
+        auto r = (color >> 11) & 31;
+        auto g = (color >> 5) & 63;
+        auto b = color & 31;
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    }
+
+    bool readContainer(std::string path, std::string sourcePath, uint64_t size, int64_t mtime,
+                       glc::CompressedImage& image)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (! file)
+        {
+            return false;
+        }
+
+        auto bytes = std::vector<char>(std::istreambuf_iterator<char>(file),
+                                       std::istreambuf_iterator<char>());
+        if (bytes.size() < sizeof(Header))
+        {
+            return false;
+        }
+
+        auto header = Header();
+        std::memcpy(&header, bytes.data(), sizeof(Header));
+
+        auto valid = std::memcmp(header.magic, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC)) == 0
+            && header.version == CONTAINER_VERSION
+            && header.format <= uint32_t(glc::BlockFormat::BC5)
+            && header.sourceSize == size;
+
+        // A touched but otherwise identical source keeps its container.
+        if (valid && header.sourceMtime != mtime)
+        {
+            valid = header.sourceHash == glc::hashFile(sourcePath);
+        }
+
+        auto entriesEnd = sizeof(Header) + uint64_t(header.numLevels) * sizeof(LevelEntry);
+        if (! valid || entriesEnd > bytes.size())
+        {
+            return false;
+        }
+
+        image.format = static_cast<glc::BlockFormat>(header.format);
+        image.levels.clear();
+
+        auto dataSize = uint64_t(bytes.size()) - entriesEnd;
+        for (size_t i = 0; i < header.numLevels; i++)
+        {
+            auto entry = LevelEntry();
+            std::memcpy(&entry, bytes.data() + sizeof(Header) + i * sizeof(LevelEntry), sizeof(entry));
+            if (entry.offset + entry.size > dataSize)
+            {
+                return false;
+            }
+
+            auto level = glc::MipLevel();
+            level.width = entry.width;
+            level.height = entry.height;
+            level.offset = entry.offset;
+            level.size = entry.size;
+            image.levels.emplace_back(level);
+        }
+
+        image.data.assign(bytes.begin() + entriesEnd, bytes.end());
+        return true;
+    }
+
+    bool writeContainer(std::string path, uint64_t size, int64_t mtime, uint64_t hash,
+                        const glc::CompressedImage& image)
+    {
+        auto header = Header();
+        std::memcpy(header.magic, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC));
+        header.version = CONTAINER_VERSION;
+        header.format = static_cast<uint32_t>(image.format);
+        header.numLevels = image.levels.size();
+        header.sourceSize = size;
+        header.sourceMtime = mtime;
+        header.sourceHash = hash;
+
+        // Write to the side and rename so a crash never leaves a torn file.
+        auto tmpPath = path + ".tmp";
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        for (const auto& l : image.levels)
+        {
+            auto entry = LevelEntry();
+            entry.width = l.width;
+            entry.height = l.height;
+            entry.offset = l.offset;
+            entry.size = l.size;
+            file.write(reinterpret_cast<const char*>(&entry), sizeof(LevelEntry));
+        }
+        file.write(reinterpret_cast<const char*>(image.data.data()), image.data.size());
+        file.close();
+
+        if (! file || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+        {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+
+        return true;
+    }
+}
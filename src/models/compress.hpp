@@ -0,0 +1,64 @@
+#pragma once
+
+#ifndef GLC_COMPRESS_HPP
+#define GLC_COMPRESS_HPP
+
+#include "texture.hpp"
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace glc {
+    class ThreadPool;
+
+    enum class BlockFormat
+    {
+        // 8 bytes per 4x4 block, opaque RGB.
+        BC1,
+        // 16 bytes per 4x4 block, RGB plus interpolated alpha.
+        BC3,
+        // 8 bytes per 4x4 block, a single channel (grey).
+        BC4,
+        // 16 bytes per 4x4 block, two independent channels (grey in R,
+        // alpha in G).
+        BC5
+    };
+
+    struct MipLevel
+    {
+        GLsizei width;
+        GLsizei height;
+        size_t offset;
+        size_t size;
+    };
+
+    // Block-compressed image with its full mip chain, largest level first.
+    struct CompressedImage
+    {
+        glc::BlockFormat format;
+        std::vector<glc::MipLevel> levels;
+        std::vector<unsigned char> data;
+    };
+
+    // BC4 for grey images, BC5 for grey plus alpha, BC1 for other opaque
+    // ones, BC3 otherwise.
+    glc::BlockFormat chooseBlockFormat(const glc::Image& image);
+
+    // Encodes the image and its mips, filtered as glc::makeMipChain() does.
+    // With a pool, rows of blocks are spread across its workers; never pass
+    // one from inside a pool job.
+    glc::CompressedImage compressImage(const glc::Image& image, glc::BlockFormat format,
+                                       glc::ThreadPool* pool = nullptr, bool srgb = true);
+
+    // Returns the compressed version of the image at path, reusing the
+    // <path>.glctex container next to it (<path>.linear.glctex when srgb is
+    // false) while the source is unchanged and writing a fresh one
+    // otherwise. Safe to call from any thread.
+    glc::CompressedImage loadCompressedImage(std::string path, glc::ThreadPool* pool = nullptr,
+                                             bool srgb = true);
+}
+
+#endif
@@ -0,0 +1,174 @@
+#include "mipmap.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+    // Resolution of the linear to sRGB table; fine enough to round-trip
+    // every 8-bit value.
+    const size_t LINEAR_STEPS = 4096;
+
+    glc::TexTier textureTier = glc::TexTier::FULL;
+
+    struct GammaTables
+    {
+        float toLinear[256];
+        unsigned char toSrgb[LINEAR_STEPS];
+        // Identity, for alpha and non-colour data.
+        float toUnit[256];
+        unsigned char fromUnit[LINEAR_STEPS];
+    };
+
+    const GammaTables& getTables();
+    void downsample(const glc::Image& source, glc::Image& target,
+                    const float* toLinear[4], const unsigned char* toByte[4]);
+}
+
+void glc::setTextureTier(glc::TexTier tier)
+{
+    ::textureTier = tier;
+}
+
+glc::TexTier glc::getTextureTier()
+{
+    return ::textureTier;
+}
+
+size_t glc::getSkippedLevels(size_t numLevels)
+{
+    auto skip = size_t(0);
+    if (::textureTier == glc::TexTier::HALF)
+    {
+        skip = 1;
+    }
+    else if (::textureTier == glc::TexTier::QUARTER)
+    {
+        skip = 2;
+    }
+
+    return numLevels ? std::min(skip, numLevels - 1) : 0;
+}
+
+std::vector<glc::Image> glc::makeMipChain(const glc::Image& image, bool srgb)
+{
+    std::vector<glc::Image> levels{image};
+    if (image.pixels.empty())
+    {
+        return levels;
+    }
+
+    // Pixels are BGRA; alpha never goes through the gamma curve.
+    const auto& tables = ::getTables();
+    const float* toLinear[4] = {tables.toLinear, tables.toLinear, tables.toLinear, tables.toUnit};
+    const unsigned char* toByte[4] = {tables.toSrgb, tables.toSrgb, tables.toSrgb, tables.fromUnit};
+    if (! srgb)
+    {
+        toLinear[0] = toLinear[1] = toLinear[2] = tables.toUnit;
+        toByte[0] = toByte[1] = toByte[2] = tables.fromUnit;
+    }
+
+    while (levels.back().width > 1 || levels.back().height > 1)
+    {
+        const auto& source = levels.back();
+        auto mip = glc::Image();
+        mip.width = std::max(source.width / 2, 1);
+        mip.height = std::max(source.height / 2, 1);
+        mip.channels = source.channels;
+        mip.pixels.resize(size_t(mip.width) * mip.height * 4);
+        ::downsample(source, mip, toLinear, toByte);
+        levels.emplace_back(std::move(mip));
+    }
+
+    return levels;
+}
+
+
+namespace {
+    const GammaTables& getTables()
+    {
+        static const GammaTables tables = []() {
+            auto t = GammaTables();
+            for (size_t i = 0; i < 256; i++)
+            {
+                auto c = i / 255.0f;
+                t.toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+                t.toUnit[i] = c;
+            }
+
+            for (size_t i = 0; i < LINEAR_STEPS; i++)
+            {
+                auto l = i / float(LINEAR_STEPS - 1);
+                auto c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+                t.toSrgb[i] = static_cast<unsigned char>(c * 255.0f + 0.5f);
+                t.fromUnit[i] = static_cast<unsigned char>(l * 255.0f + 0.5f);
+            }
+
+            return t;
+        }();
+
+        return tables;
+    }
+
+    void downsample(const glc::Image& source, glc::Image& target,
+                    const float* toLinear[4], const unsigned char* toByte[4])
+    {
+        // 2x2 box filter; odd edges clamp onto the last row or column. The
+        // table lookups stay scalar, the four channels of a texel are
+        // summed and scaled as one vector.
+        const auto scale = 0.25f * (LINEAR_STEPS - 1);
+
+        for (GLsizei y = 0; y < target.height; y++)
+        {
+            auto y0 = std::min(y * 2, source.height - 1);
+            auto y1 = std::min(y * 2 + 1, source.height - 1);
+            const auto* row0 = source.pixels.data() + size_t(y0) * source.width * 4;
+            const auto* row1 = source.pixels.data() + size_t(y1) * source.width * 4;
+            auto* dst = target.pixels.data() + size_t(y) * target.width * 4;
+
+            for (GLsizei x = 0; x < target.width; x++)
+            {
+                auto x0 = size_t(std::min(x * 2, source.width - 1)) * 4;
+                auto x1 = size_t(std::min(x * 2 + 1, source.width - 1)) * 4;
+
+                alignas(32) float texels[4][4];
+                for (size_t c = 0; c < 4; c++)
+                {
+                    texels[0][c] = toLinear[c][row0[x0 + c]];
+                    texels[1][c] = toLinear[c][row0[x1 + c]];
+                    texels[2][c] = toLinear[c][row1[x0 + c]];
+                    texels[3][c] = toLinear[c][row1[x1 + c]];
+                }
+
+                alignas(16) float sum[4];
+#if defined(__AVX2__)
+                auto top = _mm256_load_ps(texels[0]);
+                auto bottom = _mm256_load_ps(texels[2]);
+                auto pairs = _mm256_add_ps(top, bottom);
+                auto total = _mm_add_ps(_mm256_castps256_ps128(pairs), _mm256_extractf128_ps(pairs, 1));
+                _mm_store_ps(sum, _mm_mul_ps(total, _mm_set1_ps(scale)));
+#elif defined(__SSE2__)
+                auto total = _mm_add_ps(_mm_add_ps(_mm_load_ps(texels[0]), _mm_load_ps(texels[1])),
+                                        _mm_add_ps(_mm_load_ps(texels[2]), _mm_load_ps(texels[3])));
+                _mm_store_ps(sum, _mm_mul_ps(total, _mm_set1_ps(scale)));
+#else
+                for (size_t c = 0; c < 4; c++)
+                {
+                    sum[c] = (texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c]) * scale;
+                }
+#endif
+
+                for (size_t c = 0; c < 4; c++)
+                {
+                    auto step = std::min(size_t(sum[c] + 0.5f), LINEAR_STEPS - 1);
+                    dst[x * 4 + c] = toByte[c][step];
+                }
+            }
+        }
+    }
+}
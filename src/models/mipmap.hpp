@@ -0,0 +1,35 @@
+#pragma once
+
+#ifndef GLC_MIPMAP_HPP
+#define GLC_MIPMAP_HPP
+
+#include "texture.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace glc {
+    // Largest mip level uploaded, for memory-constrained deployments.
+    enum class TexTier
+    {
+        FULL,
+        HALF,
+        QUARTER
+    };
+
+    // Process-wide; only affects textures uploaded after the call.
+    void setTextureTier(glc::TexTier tier);
+    glc::TexTier getTextureTier();
+
+    // Levels to skip from the top of a chain of numLevels under the
+    // current tier. The smallest level is always kept.
+    size_t getSkippedLevels(size_t numLevels);
+
+    // Full chain down to 1x1, largest level first, starting with a copy of
+    // the image itself. Colour channels are box-filtered in linear space
+    // unless srgb is false; alpha is always filtered as is. Pure CPU work,
+    // meant for the loader workers.
+    std::vector<glc::Image> makeMipChain(const glc::Image& image, bool srgb = true);
+}
+
+#endif
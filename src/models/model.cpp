@@ -1,134 +1,1061 @@
 #include "model.hpp"
+#include "cache.hpp"
 #include "error.hpp"
+#include "mipmap.hpp"
+#include "optimize.hpp"
+#include "packing.hpp"
+#include "pool.hpp"
+#include "queue.hpp"
 #include "shader.hpp"
+#include "state.hpp"
+#include "texture.hpp"
 
-#include <FreeImagePlus.h>
+#include <assimp/DefaultIOSystem.h>
+#include <assimp/IOStream.hpp>
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <tuple>
+#include <unordered_set>
+
+namespace glc {
+    // Everything the CPU side of loading produces; built on a worker thread
+    // when streaming.
+    struct ModelSource
+    {
+        std::unique_ptr<glc::MeshCache> cache;
+        std::vector<glc::MeshData> meshes;
+        std::vector<glc::MeshView> views;
+        glc::TransformGraph nodes;
+        std::vector<glc::MeshInstance> instances;
+    };
+}
+
 namespace {
-    GLuint makeTexture(std::string path);
+    const auto IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs;
+
+    // Flags whose results end up in the mesh cache; the rest only affect
+    // how it gets uploaded.
+    const auto CACHED_FLAGS = glc::MODEL_OPTIMIZE | glc::MODEL_WELD | glc::MODEL_WELD_NEAR;
+
+    // Notes every file the importer opens, so the mesh cache also watches
+    // side files such as an .obj's material library.
+    class RecordingIOSystem : public Assimp::DefaultIOSystem
+    {
+    public:
+        explicit RecordingIOSystem(std::vector<std::string>& paths);
+        Assimp::IOStream* Open(const char* file, const char* mode = "rb") override;
+    private:
+        std::vector<std::string>& mPaths;
+    };
+
+    GLuint getPlaceholder(glc::TexType type);
+    GLuint getPlaceholderArray(glc::TexType type);
+    glc::Image makePlaceholderImage(glc::TexType type);
+    glm::mat4 makeMat(const aiMatrix4x4& m);
+    void setVertexAttributes(glc::VexFormat format);
 }
 
 glc::Mesh::Mesh(
-    const std::vector<glc::Vex>& vertices,
+    const glc::Vex* vertices, size_t numVertices,
     const std::vector<glc::Tex>& textures,
-    const std::vector<GLuint>& indices)
-: mVertices(vertices),
-  mTextures(textures),
-  mIndices(indices)
+    const GLuint* indices, size_t numIndices,
+    glc::VexFormat format,
+    bool keepCpuCopy)
+: mTextures(textures),
+  mVertices(),
+  mIndices(),
+  mVao(0),
+  mVbo(0),
+  mEbo(0),
+  mNumIndices(numIndices),
+  mIndexType(GL_UNSIGNED_INT),
+  mFormat(format),
+  mOffset(0.0f),
+  mScale(1.0f),
+  mMin(0.0f),
+  mMax(0.0f)
 {
+    if (keepCpuCopy)
+    {
+        mVertices.assign(vertices, vertices + numVertices);
+        mIndices.assign(indices, indices + numIndices);
+    }
+
+    if (numVertices)
+    {
+        mMin = vertices[0].pos;
+        mMax = vertices[0].pos;
+    }
+
+    for (size_t i = 1; i < numVertices; i++)
+    {
+        mMin = glm::min(mMin, vertices[i].pos);
+        mMax = glm::max(mMax, vertices[i].pos);
+    }
+
     glGenVertexArrays(1, &mVao);
     glGenBuffers(1, &mVbo);
     glGenBuffers(1, &mEbo);
 
-    glBindVertexArray(mVao);
+    auto& state = glc::StateCache::getDefault();
+    state.bindVertexArray(mVao);
 
-    auto vbytesize = mVertices.size() * sizeof(glc::Vex);
-    glBindBuffer(GL_ARRAY_BUFFER, mVbo);
-    glBufferData(GL_ARRAY_BUFFER, vbytesize, mVertices.data(), GL_STATIC_DRAW);
+    // Full vertices go up as they are; packed ones need a converted copy.
+    auto vdata = static_cast<const GLvoid*>(vertices);
+    auto packed = std::vector<unsigned char>();
+    if (format != glc::VexFormat::FULL)
+    {
+        packed = glc::packVertices(vertices, numVertices, format, mOffset, mScale);
+        vdata = packed.data();
+    }
 
-    auto ibytesize = mIndices.size() * sizeof(GLuint);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEbo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, ibytesize, mIndices.data(), GL_STATIC_DRAW);
+    auto stride = glc::getVertexStride(format);
+    auto vbytesize = numVertices * stride;
+    state.bindBuffer(GL_ARRAY_BUFFER, mVbo);
+    glBufferData(GL_ARRAY_BUFFER, vbytesize, vdata, GL_STATIC_DRAW);
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glc::Vex),
-        (GLvoid*)0);
+    // Every index fits in 16 bits when there are fewer than 65536 vertices.
+    auto idata = static_cast<const GLvoid*>(indices);
+    auto shortIndices = std::vector<GLushort>();
+    auto ibytesize = numIndices * sizeof(GLuint);
+    if (numVertices < 65536)
+    {
+        shortIndices.assign(indices, indices + numIndices);
+        idata = shortIndices.data();
+        ibytesize = numIndices * sizeof(GLushort);
+        mIndexType = GL_UNSIGNED_SHORT;
+    }
 
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glc::Vex),
-        (GLvoid*)offsetof(glc::Vex, norm));
+    state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEbo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, ibytesize, idata, GL_STATIC_DRAW);
 
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(glc::Vex),
-        (GLvoid*)offsetof(glc::Vex, uv));
+    ::setVertexAttributes(format);
 
-    glBindVertexArray(0);
+    state.bindVertexArray(0);
 }
 
-void glc::Mesh::draw(glc::Shader* shader)
+glc::Mesh::~Mesh()
 {
-    shader->use();
+    this->release();
+}
+
+glc::Mesh::Mesh(glc::Mesh&& other) noexcept
+: mTextures(std::move(other.mTextures)),
+  mVertices(std::move(other.mVertices)),
+  mIndices(std::move(other.mIndices)),
+  mVao(other.mVao),
+  mVbo(other.mVbo),
+  mEbo(other.mEbo),
+  mNumIndices(other.mNumIndices),
+  mIndexType(other.mIndexType),
+  mFormat(other.mFormat),
+  mOffset(other.mOffset),
+  mScale(other.mScale),
+  mMin(other.mMin),
+  mMax(other.mMax)
+{
+    other.mVao = 0;
+    other.mVbo = 0;
+    other.mEbo = 0;
+    other.mNumIndices = 0;
+}
+
+glc::Mesh& glc::Mesh::operator=(glc::Mesh&& other) noexcept
+{
+    if (this != &other)
+    {
+        this->release();
+
+        mTextures = std::move(other.mTextures);
+        mVertices = std::move(other.mVertices);
+        mIndices = std::move(other.mIndices);
+        mVao = other.mVao;
+        mVbo = other.mVbo;
+        mEbo = other.mEbo;
+        mNumIndices = other.mNumIndices;
+        mIndexType = other.mIndexType;
+        mFormat = other.mFormat;
+        mOffset = other.mOffset;
+        mScale = other.mScale;
+        mMin = other.mMin;
+        mMax = other.mMax;
 
-    GLuint diff = 1;
-    GLuint spec = 1;
-    for (size_t i = 0; i < mTextures.size(); i++)
+        other.mVao = 0;
+        other.mVbo = 0;
+        other.mEbo = 0;
+        other.mNumIndices = 0;
+    }
+
+    return *this;
+}
+
+void glc::Mesh::draw(glc::Shader* shader, const glc::MeshUniforms& uniforms)
+{
+    this->bind(shader, uniforms);
+    glDrawElements(GL_TRIANGLES, mNumIndices, mIndexType, 0);
+}
+
+void glc::Mesh::drawInstanced(glc::Shader* shader, const glc::MeshUniforms& uniforms,
+                              GLsizei count)
+{
+    this->bind(shader, uniforms);
+    glDrawElementsInstanced(GL_TRIANGLES, mNumIndices, mIndexType, 0, count);
+}
+
+void glc::Mesh::setInstanceBuffer(GLuint buffer)
+{
+    auto& state = glc::StateCache::getDefault();
+    state.bindVertexArray(mVao);
+    state.bindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    // Matrix attributes take one location per column.
+    auto stride = static_cast<GLsizei>(sizeof(glc::InstanceData));
+    for (GLuint i = 0; i < 4; i++)
+    {
+        auto location = glc::INSTANCE_MODEL_LOCATION + i;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride,
+            (GLvoid*)(offsetof(glc::InstanceData, model) + i * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+    }
+
+    for (GLuint i = 0; i < 3; i++)
     {
-        std::string symbol = "Material.";
+        auto location = glc::INSTANCE_NORMAL_LOCATION + i;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, stride,
+            (GLvoid*)(offsetof(glc::InstanceData, normal) + i * sizeof(glm::vec3)));
+        glVertexAttribDivisor(location, 1);
+    }
+}
 
-        switch (mTextures[i].type)
+bool glc::Mesh::findTexture(glc::TexType type, glc::Tex& tex) const
+{
+    // The shader reads both maps the same way, so once either is in an
+    // array the other stands in as layer 0 of a one-layer placeholder.
+    auto arrays = std::any_of(mTextures.begin(), mTextures.end(),
+        [](const glc::Tex& t)
         {
-        case glc::TexType::DIFF:
-            symbol += "texture_diffuse" + std::to_string(diff);
-            diff += 1;
-            break;
-        case glc::TexType::SPEC:
-            symbol += "texture_specular" + std::to_string(spec);
-            spec += 1;
-            break;
+            return t.layer >= 0;
+        });
+
+    for (const auto& t : mTextures)
+    {
+        if (t.type == type)
+        {
+            // Textures still streaming in are stood in for by a 1x1 placeholder.
+            tex = t;
+            tex.id = t.id ? t.id : ::getPlaceholder(type);
+            if (arrays && t.layer < 0)
+            {
+                tex.id = ::getPlaceholderArray(type);
+                tex.layer = 0;
+            }
+            return true;
         }
+    }
 
-        glActiveTexture(GL_TEXTURE0 + i);
-        glBindTexture(GL_TEXTURE_2D, mTextures[i].id);
-        shader->setUniform(symbol, static_cast<GLint>(i));
+    // So is a map the mesh lacks, since the shader samples both regardless.
+    tex.id = arrays ? ::getPlaceholderArray(type) : ::getPlaceholder(type);
+    tex.type = type;
+    tex.layer = arrays ? 0 : -1;
+    return false;
+}
+
+void glc::Mesh::setUniforms(glc::Shader* shader, const glc::MeshUniforms& uniforms) const
+{
+    auto arrays = false;
+    for (auto type : {glc::TexType::DIFF, glc::TexType::SPEC})
+    {
+        auto tex = glc::Tex();
+        this->findTexture(type, tex);
+
+        auto diffuse = type == glc::TexType::DIFF;
+        if (tex.layer >= 0)
+        {
+            shader->setUniform(diffuse ? uniforms.diffuseLayer : uniforms.specularLayer, tex.layer);
+            arrays = true;
+        }
+        else
+        {
+            shader->setUniform(diffuse ? uniforms.diffuse : uniforms.specular,
+                               diffuse ? glc::DIFFUSE_UNIT : glc::SPECULAR_UNIT);
+        }
     }
 
-    glBindVertexArray(mVao);
-    glDrawElements(GL_TRIANGLES, mIndices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    // Set even without arrays, so they never alias the 2D samplers' unit.
+    shader->setUniform(uniforms.diffuseArray, glc::DIFFUSE_ARRAY_UNIT);
+    shader->setUniform(uniforms.specularArray, glc::SPECULAR_ARRAY_UNIT);
+    shader->setUniform(uniforms.textureArrays, static_cast<GLint>(arrays));
+    shader->setUniform(uniforms.vertexOffset, mOffset);
+    shader->setUniform(uniforms.vertexScale, mScale);
+    shader->setUniform(uniforms.packedNormals, static_cast<GLint>(mFormat != glc::VexFormat::FULL));
+}
+
+GLuint glc::Mesh::getVertexArray() const
+{
+    return mVao;
+}
+
+void glc::Mesh::setTexture(size_t slot, GLuint id)
+{
+    mTextures[slot].id = id;
+    mTextures[slot].layer = -1;
+}
+
+void glc::Mesh::setTextureLayer(size_t slot, GLuint array, GLint layer)
+{
+    mTextures[slot].id = array;
+    mTextures[slot].layer = layer;
+}
+
+void glc::Mesh::removeTexture(size_t slot)
+{
+    mTextures.erase(mTextures.begin() + slot);
+}
+
+const std::vector<glc::Tex>& glc::Mesh::getTextures() const
+{
+    return mTextures;
+}
 
-    for (size_t i = 0; i < mTextures.size(); i++)
+GLsizei glc::Mesh::getNumIndices() const
+{
+    return mNumIndices;
+}
+
+GLenum glc::Mesh::getIndexType() const
+{
+    return mIndexType;
+}
+
+GLuint glc::Mesh::getVertexBuffer() const
+{
+    return mVbo;
+}
+
+GLuint glc::Mesh::getIndexBuffer() const
+{
+    return mEbo;
+}
+
+glm::vec3 glc::Mesh::getVertexOffset() const
+{
+    return mOffset;
+}
+
+glm::vec3 glc::Mesh::getVertexScale() const
+{
+    return mScale;
+}
+
+glm::vec3 glc::Mesh::getMin() const
+{
+    return mMin;
+}
+
+glm::vec3 glc::Mesh::getMax() const
+{
+    return mMax;
+}
+
+const std::vector<glc::Vex>& glc::Mesh::getVertices() const
+{
+    return mVertices;
+}
+
+const std::vector<GLuint>& glc::Mesh::getIndices() const
+{
+    return mIndices;
+}
+
+void glc::Mesh::bind(glc::Shader* shader, const glc::MeshUniforms& uniforms)
+{
+    auto& state = glc::StateCache::getDefault();
+
+    for (auto type : {glc::TexType::DIFF, glc::TexType::SPEC})
     {
-        glActiveTexture(GL_TEXTURE0 + i);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        // Bound even when missing, so no unit keeps the previous mesh's map.
+        auto tex = glc::Tex();
+        this->findTexture(type, tex);
+
+        auto diffuse = type == glc::TexType::DIFF;
+        if (tex.layer >= 0)
+        {
+            state.bindTexture(diffuse ? glc::DIFFUSE_ARRAY_UNIT : glc::SPECULAR_ARRAY_UNIT,
+                              GL_TEXTURE_2D_ARRAY, tex.id);
+        }
+        else
+        {
+            state.bindTexture(diffuse ? glc::DIFFUSE_UNIT : glc::SPECULAR_UNIT,
+                              GL_TEXTURE_2D, tex.id);
+        }
+    }
+
+    this->setUniforms(shader, uniforms);
+
+    state.bindVertexArray(mVao);
+}
+
+void glc::Mesh::release()
+{
+    // Deleting the name 0 is a no-op, so moved-from meshes are safe.
+    auto& state = glc::StateCache::getDefault();
+    state.deleteVertexArrays(1, &mVao);
+    state.deleteBuffers(1, &mVbo);
+    state.deleteBuffers(1, &mEbo);
+    mVao = 0;
+    mVbo = 0;
+    mEbo = 0;
+}
+
+
+bool glc::isMultiDrawSupported()
+{
+    return GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance &&
+                                GLEW_ARB_shader_storage_buffer_object);
+}
+
+glc::MeshBatch::MeshBatch()
+: mVao(0),
+  mVertices(),
+  mIndices(),
+  mCommands(),
+  mDrawIndices(),
+  mDraws(),
+  mDrawData(),
+  mDrawNodes(),
+  mCalls(),
+  mPackedNormals(false)
+{
+}
+
+glc::MeshBatch::~MeshBatch()
+{
+    this->release();
+}
+
+glc::MeshBatch::MeshBatch(glc::MeshBatch&& other) noexcept
+: mVao(other.mVao),
+  mVertices(std::move(other.mVertices)),
+  mIndices(std::move(other.mIndices)),
+  mCommands(std::move(other.mCommands)),
+  mDrawIndices(std::move(other.mDrawIndices)),
+  mDraws(std::move(other.mDraws)),
+  mDrawData(std::move(other.mDrawData)),
+  mDrawNodes(std::move(other.mDrawNodes)),
+  mCalls(std::move(other.mCalls)),
+  mPackedNormals(other.mPackedNormals)
+{
+    other.mVao = 0;
+}
+
+glc::MeshBatch& glc::MeshBatch::operator=(glc::MeshBatch&& other) noexcept
+{
+    if (this != &other)
+    {
+        this->release();
+
+        mVao = other.mVao;
+        mVertices = std::move(other.mVertices);
+        mIndices = std::move(other.mIndices);
+        mCommands = std::move(other.mCommands);
+        mDrawIndices = std::move(other.mDrawIndices);
+        mDraws = std::move(other.mDraws);
+        mDrawData = std::move(other.mDrawData);
+        mDrawNodes = std::move(other.mDrawNodes);
+        mCalls = std::move(other.mCalls);
+        mPackedNormals = other.mPackedNormals;
+
+        other.mVao = 0;
+    }
+
+    return *this;
+}
+
+void glc::MeshBatch::build(const std::vector<glc::Mesh>& meshes,
+                           const std::vector<glc::MeshInstance>& instances,
+                           glc::VexFormat format)
+{
+    auto& state = glc::StateCache::getDefault();
+    auto stride = glc::getVertexStride(format);
+
+    // Each mesh goes in once, however many instances draw it. Index runs
+    // start 4-byte aligned so either type lands on a whole firstIndex.
+    std::vector<GLint> baseVertices(meshes.size());
+    std::vector<GLuint> firstIndices(meshes.size());
+    std::vector<GLintptr> vertexOffsets(meshes.size());
+    std::vector<GLintptr> indexOffsets(meshes.size());
+    std::vector<GLint> vertexSizes(meshes.size());
+    GLsizeiptr vertexBytes = 0;
+    GLsizeiptr indexBytes = 0;
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        state.bindBuffer(GL_COPY_READ_BUFFER, meshes[i].getVertexBuffer());
+        glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &vertexSizes[i]);
+        vertexOffsets[i] = vertexBytes;
+        baseVertices[i] = static_cast<GLint>(vertexBytes / stride);
+        vertexBytes += vertexSizes[i];
+
+        auto indexSize = meshes[i].getIndexType() == GL_UNSIGNED_SHORT
+            ? sizeof(GLushort) : sizeof(GLuint);
+        indexBytes = (indexBytes + 3) & ~GLsizeiptr(3);
+        indexOffsets[i] = indexBytes;
+        firstIndices[i] = static_cast<GLuint>(indexBytes / indexSize);
+        indexBytes += meshes[i].getNumIndices() * indexSize;
+    }
+
+    mVertices.upload(GL_COPY_WRITE_BUFFER, nullptr, vertexBytes, GL_STATIC_DRAW);
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        state.bindBuffer(GL_COPY_READ_BUFFER, meshes[i].getVertexBuffer());
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                            0, vertexOffsets[i], vertexSizes[i]);
+    }
+
+    mIndices.upload(GL_COPY_WRITE_BUFFER, nullptr, indexBytes, GL_STATIC_DRAW);
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        auto indexSize = meshes[i].getIndexType() == GL_UNSIGNED_SHORT
+            ? sizeof(GLushort) : sizeof(GLuint);
+        state.bindBuffer(GL_COPY_READ_BUFFER, meshes[i].getIndexBuffer());
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                            0, indexOffsets[i], meshes[i].getNumIndices() * indexSize);
+    }
+
+    // Draws sharing arrays and index type end up next to each other, so
+    // each run is one call.
+    typedef std::tuple<GLenum, GLuint, GLuint> CallKey;
+    std::vector<std::pair<CallKey, size_t>> order;
+    for (size_t i = 0; i < instances.size(); i++)
+    {
+        const auto& mesh = meshes[instances[i].mesh];
+        auto diffuse = glc::Tex();
+        auto specular = glc::Tex();
+        mesh.findTexture(glc::TexType::DIFF, diffuse);
+        mesh.findTexture(glc::TexType::SPEC, specular);
+        order.emplace_back(CallKey(mesh.getIndexType(), diffuse.layer >= 0 ? diffuse.id : 0,
+                                   specular.layer >= 0 ? specular.id : 0), i);
+    }
+    std::stable_sort(order.begin(), order.end(),
+        [](const std::pair<CallKey, size_t>& a, const std::pair<CallKey, size_t>& b)
+        {
+            return a.first < b.first;
+        });
+
+    std::vector<glc::DrawCommand> commands;
+    std::vector<GLint> drawIndices;
+    mDrawData.clear();
+    mDrawNodes.clear();
+    mCalls.clear();
+    for (const auto& entry : order)
+    {
+        const auto& instance = instances[entry.second];
+        const auto& mesh = meshes[instance.mesh];
+        auto draw = static_cast<GLuint>(commands.size());
+
+        commands.push_back(glc::DrawCommand{
+            static_cast<GLuint>(mesh.getNumIndices()), 1,
+            firstIndices[instance.mesh], baseVertices[instance.mesh], draw});
+        drawIndices.push_back(static_cast<GLint>(draw));
+
+        auto data = glc::DrawBlock();
+        data.offset = glm::vec4(mesh.getVertexOffset(), 0.0f);
+        data.scale = glm::vec4(mesh.getVertexScale(), 0.0f);
+        auto tex = glc::Tex();
+        mesh.findTexture(glc::TexType::DIFF, tex);
+        if (tex.layer >= 0)
+        {
+            data.layers.x = tex.layer;
+        }
+        mesh.findTexture(glc::TexType::SPEC, tex);
+        if (tex.layer >= 0)
+        {
+            data.layers.y = tex.layer;
+        }
+        mDrawData.push_back(data);
+        mDrawNodes.push_back(instance.node);
+
+        const auto& key = entry.first;
+        if (mCalls.empty() || mCalls.back().indexType != std::get<0>(key) ||
+            mCalls.back().diffuseArray != std::get<1>(key) ||
+            mCalls.back().specularArray != std::get<2>(key))
+        {
+            mCalls.push_back(Call{std::get<1>(key), std::get<2>(key), std::get<0>(key), draw, 0});
+        }
+        mCalls.back().count++;
+    }
+
+    mCommands.upload(GL_DRAW_INDIRECT_BUFFER, commands.data(),
+                     commands.size() * sizeof(glc::DrawCommand), GL_STATIC_DRAW);
+
+    glGenVertexArrays(1, &mVao);
+    state.bindVertexArray(mVao);
+    state.bindBuffer(GL_ARRAY_BUFFER, mVertices.getHandle());
+    ::setVertexAttributes(format);
+    state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndices.getHandle());
+
+    // With one instance per command, baseInstance alone picks the entry.
+    mDrawIndices.upload(GL_ARRAY_BUFFER, drawIndices.data(),
+                        drawIndices.size() * sizeof(GLint), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(glc::DRAW_INDEX_LOCATION);
+    glVertexAttribIPointer(glc::DRAW_INDEX_LOCATION, 1, GL_INT, 0, 0);
+    glVertexAttribDivisor(glc::DRAW_INDEX_LOCATION, 1);
+
+    mPackedNormals = format != glc::VexFormat::FULL;
+
+    std::cout << "Batched " << commands.size() << " draws of " << meshes.size()
+              << " meshes into " << mCalls.size() << " multi-draw calls\n";
+}
+
+bool glc::MeshBatch::isBuilt() const
+{
+    return mVao != 0;
+}
+
+void glc::MeshBatch::draw(glc::Shader* shader, const glc::MeshUniforms& uniforms,
+                          const glc::TransformGraph& nodes)
+{
+    for (size_t i = 0; i < mDrawData.size(); i++)
+    {
+        mDrawData[i].world = nodes.getWorld(mDrawNodes[i]);
+        mDrawData[i].normal = glm::mat4(nodes.getNormal(mDrawNodes[i]));
+    }
+
+    auto& state = glc::StateCache::getDefault();
+    mDraws.upload(GL_SHADER_STORAGE_BUFFER, mDrawData.data(),
+                  mDrawData.size() * sizeof(glc::DrawBlock));
+    state.bindBufferBase(GL_SHADER_STORAGE_BUFFER,
+                         static_cast<GLuint>(glc::StorageBinding::DRAWS), mDraws.getHandle());
+
+    shader->setUniform(uniforms.diffuseArray, glc::DIFFUSE_ARRAY_UNIT);
+    shader->setUniform(uniforms.specularArray, glc::SPECULAR_ARRAY_UNIT);
+    shader->setUniform(uniforms.textureArrays, 1);
+    shader->setUniform(uniforms.packedNormals, static_cast<GLint>(mPackedNormals));
+
+    state.bindVertexArray(mVao);
+    state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommands.getHandle());
+    for (const auto& call : mCalls)
+    {
+        state.bindTexture(glc::DIFFUSE_ARRAY_UNIT, GL_TEXTURE_2D_ARRAY, call.diffuseArray);
+        state.bindTexture(glc::SPECULAR_ARRAY_UNIT, GL_TEXTURE_2D_ARRAY, call.specularArray);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, call.indexType,
+                                    (GLvoid*)(call.first * sizeof(glc::DrawCommand)),
+                                    call.count, 0);
     }
 }
 
+size_t glc::MeshBatch::getNumDraws() const
+{
+    return mDrawData.size();
+}
+
+size_t glc::MeshBatch::getNumCalls() const
+{
+    return mCalls.size();
+}
 
-glc::Model::Model(std::string path)
+void glc::MeshBatch::release()
+{
+    glc::StateCache::getDefault().deleteVertexArrays(1, &mVao);
+    mVao = 0;
+}
+
+
+glc::Model::Model(std::string path, glc::LoadMode mode, unsigned int flags)
 : mMeshes(),
+  mInstances(),
+  mNodes(),
   mLoadedTextures(),
-  mBaseDirectory(path.substr(0, path.find_last_of("/")))
+  mPath(path),
+  mBaseDirectory(path.substr(0, path.find_last_of("/"))),
+  mFormat(glc::VexFormat::FULL),
+  mKeepCpuCopy(flags & glc::MODEL_KEEP_CPU_COPY),
+  mPackTextures(flags & glc::MODEL_TEXTURE_ARRAYS),
+  mStartTime(std::chrono::steady_clock::now()),
+  mPendingSource(),
+  mSource(),
+  mNextMesh(0),
+  mPendingTextures(),
+  mPendingSlots(),
+  mDecodedTextures(),
+  mTextureArrays(),
+  mUniforms(),
+  mInstanceData(),
+  mInstanceBuffer(),
+  mInstancedMeshes(0),
+  mBatch(),
+  mLoaded(false)
+{
+    if (flags & glc::MODEL_QUANTIZE)
+    {
+        mFormat = glc::VexFormat::QUANTIZED;
+    }
+    else if (flags & glc::MODEL_PACK)
+    {
+        mFormat = glc::VexFormat::PACKED;
+    }
+
+    if (mode == glc::LoadMode::STREAMING)
+    {
+        auto& pool = glc::ThreadPool::getDefault();
+        mPendingSource = pool.submit([path, flags]() { return loadSource(path, flags); });
+        return;
+    }
+
+    mSource = loadSource(path, flags);
+    mInstances = mSource->instances;
+    mNodes = mSource->nodes;
+    this->queueTextures();
+
+    while (this->uploadTexture(true))
+    {
+        continue;
+    }
+
+    for (const auto& m : mSource->views)
+    {
+        this->addMesh(m.vertices, m.numVertices, m.indices, m.numIndices, m.textures);
+    }
+
+    this->finishLoading();
+}
+
+glc::Model::Model(glc::Model&& other)
+: mMeshes(std::move(other.mMeshes)),
+  mInstances(std::move(other.mInstances)),
+  mNodes(std::move(other.mNodes)),
+  mLoadedTextures(std::move(other.mLoadedTextures)),
+  mPath(std::move(other.mPath)),
+  mBaseDirectory(std::move(other.mBaseDirectory)),
+  mFormat(other.mFormat),
+  mKeepCpuCopy(other.mKeepCpuCopy),
+  mPackTextures(other.mPackTextures),
+  mStartTime(other.mStartTime),
+  mPendingSource(std::move(other.mPendingSource)),
+  mSource(std::move(other.mSource)),
+  mNextMesh(other.mNextMesh),
+  mPendingTextures(std::move(other.mPendingTextures)),
+  mPendingSlots(std::move(other.mPendingSlots)),
+  mDecodedTextures(std::move(other.mDecodedTextures)),
+  mTextureArrays(std::move(other.mTextureArrays)),
+  mUniforms(std::move(other.mUniforms)),
+  mInstanceData(std::move(other.mInstanceData)),
+  mInstanceBuffer(std::move(other.mInstanceBuffer)),
+  mInstancedMeshes(other.mInstancedMeshes),
+  mBatch(std::move(other.mBatch)),
+  mLoaded(other.mLoaded)
+{
+    other.mTextureArrays.clear();
+}
+
+glc::Model::~Model()
+{
+    glc::StateCache::getDefault().deleteTextures(mTextureArrays.size(), mTextureArrays.data());
+}
+
+void glc::Model::update(float budget)
+{
+    if (mLoaded)
+    {
+        return;
+    }
+
+    if (! mSource)
+    {
+        auto status = mPendingSource.wait_for(std::chrono::seconds(0));
+        if (status != std::future_status::ready)
+        {
+            return;
+        }
+
+        mSource = mPendingSource.get();
+        mInstances = mSource->instances;
+        mNodes = mSource->nodes;
+        this->queueTextures();
+    }
+
+    // Upload one mesh or texture at a time until this frame's budget is
+    // spent, so the main loop never stalls on a big batch.
+    auto deadline = std::chrono::steady_clock::now()
+        + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<float>(budget));
+
+    do
+    {
+        if (mNextMesh < mSource->views.size())
+        {
+            const auto& m = mSource->views[mNextMesh++];
+            this->addMesh(m.vertices, m.numVertices, m.indices, m.numIndices, m.textures);
+        }
+        else if (! this->uploadTexture(false))
+        {
+            break;
+        }
+    }
+    while (std::chrono::steady_clock::now() < deadline);
+
+    if (mNextMesh == mSource->views.size() && mPendingTextures.empty())
+    {
+        this->finishLoading();
+    }
+}
+
+void glc::Model::draw(glc::Shader* shader, glm::mat4 transform)
+{
+    shader->use();
+    mNodes.update();
+
+    const auto& uniforms = this->resolveUniforms(shader);
+
+    // The inverse transpose distributes over the product, so only the
+    // model-level part needs inverting here.
+    auto normal = glm::mat3(glm::transpose(glm::inverse(transform)));
+
+    for (const auto& instance : mInstances)
+    {
+        // Meshes upload in order, so anything past the end is still streaming.
+        if (instance.mesh >= mMeshes.size())
+        {
+            continue;
+        }
+
+        shader->setUniform(uniforms.model, transform * mNodes.getWorld(instance.node));
+        shader->setUniform(uniforms.normal, normal * mNodes.getNormal(instance.node));
+        mMeshes[instance.mesh].draw(shader, uniforms);
+    }
+}
+
+void glc::Model::submit(glc::RenderQueue& queue, glc::Shader* shader,
+                        glm::mat4 transform, unsigned int pass)
+{
+    shader->wait();
+    mNodes.update();
+
+    const auto& uniforms = this->resolveUniforms(shader);
+
+    auto normal = glm::mat3(glm::transpose(glm::inverse(transform)));
+
+    for (const auto& instance : mInstances)
+    {
+        if (instance.mesh < mMeshes.size())
+        {
+            queue.add(pass, shader, &uniforms, &mMeshes[instance.mesh],
+                      transform * mNodes.getWorld(instance.node),
+                      normal * mNodes.getNormal(instance.node));
+        }
+    }
+}
+
+void glc::Model::drawInstanced(glc::Shader* shader, const glm::mat4* transforms, size_t count)
+{
+    if (! count)
+    {
+        return;
+    }
+
+    shader->use();
+    mNodes.update();
+
+    const auto& uniforms = this->resolveUniforms(shader);
+
+    // Normal matrices are worked out here once per instance rather than
+    // per vertex in the shader.
+    mInstanceData.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        mInstanceData[i].model = transforms[i];
+        mInstanceData[i].normal = glm::mat3(glm::transpose(glm::inverse(transforms[i])));
+    }
+
+    mInstanceBuffer.upload(GL_ARRAY_BUFFER, mInstanceData.data(),
+                           count * sizeof(glc::InstanceData));
+
+    // Meshes still streaming in get hooked up as they arrive.
+    for (; mInstancedMeshes < mMeshes.size(); mInstancedMeshes++)
+    {
+        mMeshes[mInstancedMeshes].setInstanceBuffer(mInstanceBuffer.getHandle());
+    }
+
+    // The node part of each transform stays a uniform, shared by every
+    // instance; the shader puts the instance transform on top of it.
+    for (const auto& instance : mInstances)
+    {
+        if (instance.mesh >= mMeshes.size())
+        {
+            continue;
+        }
+
+        shader->setUniform(uniforms.model, mNodes.getWorld(instance.node));
+        shader->setUniform(uniforms.normal, mNodes.getNormal(instance.node));
+        mMeshes[instance.mesh].drawInstanced(shader, uniforms, static_cast<GLsizei>(count));
+    }
+}
+
+void glc::Model::drawIndirect(glc::Shader* shader, glm::mat4 transform)
 {
+    if (! mLoaded)
+    {
+        return;
+    }
+
+    shader->use();
+    mNodes.update();
+
+    const auto& uniforms = this->resolveUniforms(shader);
+
+    // Built only once loading is over, when every layer is final.
+    if (! mBatch.isBuilt())
+    {
+        mBatch.build(mMeshes, mInstances, mFormat);
+    }
+
+    shader->setUniform(uniforms.model, transform);
+    shader->setUniform(uniforms.normal, glm::mat3(glm::transpose(glm::inverse(transform))));
+    mBatch.draw(shader, uniforms, mNodes);
+}
+
+bool glc::Model::isLoaded() const
+{
+    return mLoaded;
+}
+
+int glc::Model::findNode(const std::string& name) const
+{
+    return mNodes.findNode(name);
+}
+
+void glc::Model::setNodeTransform(size_t node, glm::mat4 local)
+{
+    mNodes.setLocal(node, local);
+}
+
+std::shared_ptr<glc::ModelSource> glc::Model::loadSource(std::string path, unsigned int flags)
+{
+    auto source = std::make_shared<glc::ModelSource>();
+    auto options = uint64_t(IMPORT_FLAGS) | uint64_t(flags & CACHED_FLAGS) << 32;
+    source->cache.reset(new glc::MeshCache(path, options));
+
+    // Warm start: geometry comes straight out of the mapped cache file.
+    if (source->cache->load())
+    {
+        source->views = source->cache->getMeshes();
+        source->nodes = source->cache->getNodes();
+        source->instances = source->cache->getInstances();
+        return source;
+    }
+
+    // Declared before the importer so the recorded paths outlive its IO
+    // handler, which the importer owns and deletes.
+    auto dependencies = std::vector<std::string>();
     Assimp::Importer import;
-    auto scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+    import.SetIOHandler(new ::RecordingIOSystem(dependencies));
+    auto scene = import.ReadFile(path, IMPORT_FLAGS);
 
     if (! scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || ! scene->mRootNode)
     {
         throw glc::MalformedModel(path, import.GetErrorString());
     }
 
-    this->processNode(scene, scene->mRootNode);
+    // Every scene mesh is converted once, however many nodes reference it.
+    source->meshes.resize(scene->mNumMeshes);
+    for (size_t i = 0; i < scene->mNumMeshes; i++)
+    {
+        processMesh(scene, scene->mMeshes[i], source->meshes[i]);
+    }
+
+    processNode(scene->mRootNode, glc::TransformGraph::NO_PARENT, source->nodes, source->instances);
+    postProcess(source->meshes, flags);
+
+    if (! source->cache->save(source->meshes, source->nodes, source->instances, dependencies))
+    {
+        std::cout << "Failed to write mesh cache: " << source->cache->getPath() << "\n";
+    }
+
+    // Only a warm source keeps its cache around.
+    source->cache.reset();
+
+    for (const auto& m : source->meshes)
+    {
+        auto view = glc::MeshView();
+        view.vertices = m.vertices.data();
+        view.numVertices = m.vertices.size();
+        view.indices = m.indices.data();
+        view.numIndices = m.indices.size();
+        view.textures = m.textures;
+        source->views.emplace_back(view);
+    }
+
+    return source;
 }
 
-void glc::Model::draw(glc::Shader* shader)
+void glc::Model::postProcess(std::vector<glc::MeshData>& meshes, unsigned int flags)
 {
-    for (auto &m : mMeshes)
+    for (size_t i = 0; i < meshes.size(); i++)
     {
-        m.draw(shader);
+        auto& m = meshes[i];
+
+        // Weld first so the cache optimiser sees the shared vertices.
+        if (flags & (glc::MODEL_WELD | glc::MODEL_WELD_NEAR))
+        {
+            auto before = m.vertices.size();
+            auto epsilon = flags & glc::MODEL_WELD_NEAR ? glc::WELD_EPSILON : 0.0f;
+            glc::weldVertices(m.vertices, m.indices, epsilon);
+
+            auto after = m.vertices.size();
+            std::cout << "Mesh " << i
+                      << ": welded " << before << " -> " << after << " vertices, "
+                      << (before - after) * sizeof(glc::Vex) << " bytes saved\n";
+        }
+
+        if (flags & glc::MODEL_OPTIMIZE)
+        {
+            auto before = glc::analyzeVertexCache(m.indices, m.vertices.size());
+
+            glc::optimizeVertexCache(m.vertices, m.indices);
+            glc::optimizeVertexFetch(m.vertices, m.indices);
+
+            auto after = glc::analyzeVertexCache(m.indices, m.vertices.size());
+            std::cout << "Mesh " << i
+                      << ": ACMR " << before.acmr << " -> " << after.acmr
+                      << ", ATVR " << before.atvr << " -> " << after.atvr << "\n";
+        }
     }
 }
 
-void glc::Model::processNode(const aiScene* scene, const aiNode* node)
+void glc::Model::processNode(
+    const aiNode* node,
+    int parent,
+    glc::TransformGraph& nodes,
+    std::vector<glc::MeshInstance>& instances)
 {
+    // Depth-first, so every parent lands before its children.
+    auto index = nodes.addNode(parent, ::makeMat(node->mTransformation), node->mName.C_Str());
+
     for (size_t i = 0; i < node->mNumMeshes; i++)
     {
-        auto mesh = scene->mMeshes[node->mMeshes[i]];
-        this->processMesh(scene, mesh);
+        auto instance = glc::MeshInstance();
+        instance.mesh = node->mMeshes[i];
+        instance.node = index;
+        instances.emplace_back(instance);
     }
 
     for (size_t i = 0; i < node->mNumChildren; i++)
     {
-        this->processNode(scene, node->mChildren[i]);
+        processNode(node->mChildren[i], index, nodes, instances);
     }
 }
 
-void glc::Model::processMesh(const aiScene* scene, const aiMesh* mesh)
+void glc::Model::processMesh(const aiScene* scene, const aiMesh* mesh, glc::MeshData& data)
 {
-    std::vector<glc::Vex> vertices;
-    std::vector<glc::Tex> textures;
-    std::vector<GLuint> indices;
+    auto& vertices = data.vertices;
+    auto& textures = data.textures;
+    auto& indices = data.indices;
 
     for (size_t i = 0; i < mesh->mNumVertices; i++)
     {
@@ -172,71 +1099,412 @@ void glc::Model::processMesh(const aiScene* scene, const aiMesh* mesh)
     auto specMaps = getTex(mat, aiTextureType_SPECULAR);
     textures.insert(textures.end(), diffMaps.begin(), diffMaps.end());
     textures.insert(textures.end(), specMaps.begin(), specMaps.end());
-
-    mMeshes.emplace_back(vertices, textures, indices);
 }
 
-std::vector<glc::Tex> glc::Model::getTex(const aiMaterial* mat, const aiTextureType type)
+std::vector<glc::TexRef> glc::Model::getTex(const aiMaterial* mat, const aiTextureType type)
 {
-    std::vector<glc::Tex> textures;
+    std::vector<glc::TexRef> textures;
 
     for (size_t i = 0; i < mat->GetTextureCount(type); i++)
     {
         aiString str;
         mat->GetTexture(type, i, &str);
 
-        if (mLoadedTextures.count(str.C_Str()))
+        auto ref = glc::TexRef();
+        ref.path = str.C_Str();
+        switch (type)
         {
-            textures.emplace_back(mLoadedTextures[str.C_Str()]);
+        case aiTextureType_SPECULAR:
+            ref.type = glc::TexType::SPEC;
+            break;
+        case aiTextureType_DIFFUSE:
+            ref.type = glc::TexType::DIFF;
+            break;
+        default:
+            // Sooooon...
+            break;
+        }
+        textures.emplace_back(ref);
+    }
+
+    return textures;
+}
+
+void glc::Model::addMesh(
+    const glc::Vex* vertices, size_t numVertices,
+    const GLuint* indices, size_t numIndices,
+    const std::vector<glc::TexRef>& textures)
+{
+    std::vector<glc::Tex> loaded;
+    for (size_t i = 0; i < textures.size(); i++)
+    {
+        auto it = mLoadedTextures.find(textures[i].path);
+
+        // Not uploaded yet; patched in by uploadTexture() once it is.
+        auto tex = glc::Tex();
+        tex.id = it != mLoadedTextures.end() ? *it->second : 0;
+        tex.type = textures[i].type;
+        tex.layer = -1;
+        loaded.emplace_back(tex);
+
+        if (! tex.id)
+        {
+            mPendingSlots.emplace(textures[i].path, PendingSlot{mMeshes.size(), i});
+        }
+    }
+
+    mMeshes.emplace_back(vertices, numVertices, loaded, indices, numIndices,
+                         mFormat, mKeepCpuCopy);
+}
+
+const glc::MeshUniforms& glc::Model::resolveUniforms(const glc::Shader* shader)
+{
+    auto found = mUniforms.find(shader);
+    if (found != mUniforms.end())
+    {
+        return found->second;
+    }
+
+    auto& uniforms = mUniforms[shader];
+    uniforms.diffuse = shader->findUniform<GLint>("Material.texture_diffuse1");
+    uniforms.specular = shader->findUniform<GLint>("Material.texture_specular1");
+    uniforms.diffuseLayer = shader->findUniform<GLint>("Material.diffuseLayer");
+    uniforms.specularLayer = shader->findUniform<GLint>("Material.specularLayer");
+    uniforms.diffuseArray = shader->findUniform<GLint>("Material.diffuseArray");
+    uniforms.specularArray = shader->findUniform<GLint>("Material.specularArray");
+    uniforms.textureArrays = shader->findUniform<GLint>("TextureArrays");
+    uniforms.model = shader->getUniform<glm::mat4>("Model");
+    uniforms.normal = shader->getUniform<glm::mat3>("Normal");
+    // Multi-draw shaders take these per draw instead.
+    uniforms.vertexOffset = shader->findUniform<glm::vec3>("VertexOffset");
+    uniforms.vertexScale = shader->findUniform<glm::vec3>("VertexScale");
+    uniforms.packedNormals = shader->getUniform<GLint>("PackedNormals");
+    return uniforms;
+}
+
+void glc::Model::queueTextures()
+{
+    auto& pool = glc::ThreadPool::getDefault();
+    auto queued = std::unordered_set<std::string>();
+    auto compress = glc::isBlockCompressionSupported();
+    auto pack = mPackTextures;
+
+    // Decoding fans out to the workers, but uploads happen in first
+    // reference order so mLoadedTextures ends up the same on every run.
+    for (const auto& m : mSource->views)
+    {
+        for (const auto& r : m.textures)
+        {
+            if (mLoadedTextures.count(r.path) || queued.count(r.path))
+            {
+                continue;
+            }
+
+            // Images another model already uploaded are only hashed. Only
+            // diffuse maps hold colour; the rest are filtered as plain data.
+            auto path = mBaseDirectory + "/" + r.path;
+            auto srgb = r.type == glc::TexType::DIFF;
+            auto pending = PendingTex();
+            pending.path = r.path;
+            pending.srgb = srgb;
+            pending.decoded = pool.submit([path, srgb, compress, pack]() {
+                auto& registry = glc::TextureRegistry::getDefault();
+                auto decoded = DecodedTex();
+                decoded.key = glc::TextureRegistry::makeKey(path, srgb);
+                if (! pack && registry.contains(decoded.key))
+                {
+                    return decoded;
+                }
+
+                if (compress)
+                {
+                    decoded.compressed = glc::loadCompressedImage(path, nullptr, srgb);
+                }
+                if (decoded.compressed.levels.empty())
+                {
+                    decoded.levels = glc::makeMipChain(glc::decodeImage(path), srgb);
+                }
+                return decoded;
+            });
+            mPendingTextures.emplace_back(std::move(pending));
+            queued.emplace(r.path);
+        }
+    }
+}
+
+bool glc::Model::uploadTexture(bool wait)
+{
+    if (mPendingTextures.empty())
+    {
+        return false;
+    }
+
+    auto& pending = mPendingTextures.front();
+    auto status = pending.decoded.wait_for(std::chrono::seconds(0));
+    if (! wait && status != std::future_status::ready)
+    {
+        return false;
+    }
+
+    // Packed textures are held back until packTextures() has them all.
+    if (mPackTextures)
+    {
+        mDecodedTextures.emplace_back(pending.path, pending.decoded.get());
+        mPendingTextures.pop_front();
+        return true;
+    }
+
+    // Re-check: the texture may have been evicted since the worker looked,
+    // in which case it has to be decoded after all.
+    auto& registry = glc::TextureRegistry::getDefault();
+    auto decoded = pending.decoded.get();
+    auto handle = registry.find(decoded.key);
+    auto size = glc::TexSize{0, 0};
+    if (! handle && ! decoded.compressed.levels.empty())
+    {
+        handle = registry.add(decoded.key, glc::makeTexture(decoded.compressed));
+        size = glc::getTextureSize(decoded.compressed);
+    }
+    else if (! handle && ! decoded.levels.empty())
+    {
+        handle = registry.add(decoded.key, glc::makeTexture(decoded.levels));
+        size = glc::getTextureSize(decoded.levels);
+    }
+    else if (! handle)
+    {
+        auto image = glc::decodeImage(mBaseDirectory + "/" + pending.path);
+        handle = registry.add(decoded.key, glc::makeTexture(glc::makeMipChain(image, pending.srgb)));
+    }
+
+    mLoadedTextures.emplace(pending.path, handle);
+
+    if (size.uploaded)
+    {
+        std::cout << "Texture " << pending.path << ": " << size.uploaded / 1024 << " KiB, "
+                  << (size.rgba - size.uploaded) / 1024 << " KiB saved against RGBA8\n";
+    }
+
+    auto slots = mPendingSlots.equal_range(pending.path);
+    for (auto it = slots.first; it != slots.second; ++it)
+    {
+        mMeshes[it->second.mesh].setTexture(it->second.slot, *handle);
+    }
+
+    mPendingSlots.erase(pending.path);
+    mPendingTextures.pop_front();
+
+    return true;
+}
+
+void glc::Model::packTextures()
+{
+    // Group by everything a texture array needs its layers to share.
+    typedef std::tuple<bool, int, GLsizei, GLsizei, size_t> GroupKey;
+    std::map<GroupKey, std::vector<size_t>> groups;
+    for (size_t i = 0; i < mDecodedTextures.size(); i++)
+    {
+        const auto& d = mDecodedTextures[i].second;
+        if (! d.compressed.levels.empty())
+        {
+            const auto& l = d.compressed.levels[0];
+            auto format = static_cast<int>(d.compressed.format);
+            groups[GroupKey(true, format, l.width, l.height, d.compressed.levels.size())].push_back(i);
+        }
+        else if (! d.levels.empty() && ! d.levels[0].pixels.empty())
+        {
+            const auto& l = d.levels[0];
+            groups[GroupKey(false, l.channels, l.width, l.height, d.levels.size())].push_back(i);
+        }
+        else
+        {
+            std::cout << "Failed to decode texture: " << mDecodedTextures[i].first << "\n";
+        }
+    }
+
+    for (const auto& g : groups)
+    {
+        GLuint array;
+        if (std::get<0>(g.first))
+        {
+            std::vector<const glc::CompressedImage*> layers;
+            for (auto i : g.second)
+            {
+                layers.push_back(&mDecodedTextures[i].second.compressed);
+            }
+            array = glc::makeTextureArray(layers);
         }
         else
         {
-            auto tex = glc::Tex();
-            tex.id = ::makeTexture(mBaseDirectory + "/" + str.C_Str());
-            switch (type)
+            std::vector<const std::vector<glc::Image>*> layers;
+            for (auto i : g.second)
             {
-            case aiTextureType_SPECULAR:
-                tex.type = glc::TexType::SPEC;
-                break;
-            case aiTextureType_DIFFUSE:
-                tex.type = glc::TexType::DIFF;
-                break;
-            default:
-                // Sooooon...
-                break;
+                layers.push_back(&mDecodedTextures[i].second.levels);
             }
-            mLoadedTextures.emplace(str.C_Str(), tex);
-            textures.emplace_back(tex);
+            array = glc::makeTextureArray(layers);
+        }
+
+        mTextureArrays.push_back(array);
+        std::cout << "Texture array " << std::get<2>(g.first) << "x" << std::get<3>(g.first)
+                  << ": " << g.second.size() << " layers\n";
+
+        for (size_t layer = 0; layer < g.second.size(); layer++)
+        {
+            const auto& path = mDecodedTextures[g.second[layer]].first;
+            auto slots = mPendingSlots.equal_range(path);
+            for (auto it = slots.first; it != slots.second; ++it)
+            {
+                mMeshes[it->second.mesh].setTextureLayer(it->second.slot, array, layer);
+            }
+            mPendingSlots.erase(path);
         }
     }
 
-    return textures;
+    // Whatever is still pending failed to decode. Its slots go, so that the
+    // mesh treats the map as missing; last slot first, keeping the rest valid.
+    auto failed = std::vector<PendingSlot>();
+    for (const auto& s : mPendingSlots)
+    {
+        failed.push_back(s.second);
+    }
+    std::sort(failed.begin(), failed.end(),
+        [](const PendingSlot& a, const PendingSlot& b)
+        {
+            return std::tie(a.mesh, a.slot) > std::tie(b.mesh, b.slot);
+        });
+    for (const auto& s : failed)
+    {
+        mMeshes[s.mesh].removeTexture(s.slot);
+    }
+
+    mPendingSlots.clear();
+    mDecodedTextures.clear();
 }
 
+void glc::Model::finishLoading()
+{
+    if (mPackTextures)
+    {
+        this->packTextures();
+    }
+
+    auto warm = mSource->cache != nullptr;
+    auto elapsed = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - mStartTime);
+    std::cout << "Loaded " << mPath << " (" << (warm ? "warm" : "cold") << ") in "
+              << elapsed.count() << " ms\n";
+
+    // Drops the mapped cache and the imported CPU-side copies.
+    mSource.reset();
+    mLoaded = true;
+}
+
+
 namespace {
-    GLuint makeTexture(std::string path)
+    RecordingIOSystem::RecordingIOSystem(std::vector<std::string>& paths)
+    : mPaths(paths)
     {
-        GLuint id;
-        glGenTextures(1, &id);
 
-        fipImage image;
-        image.load(path.c_str());
-        image.convertTo32Bits();
-        auto data = image.accessPixels();
-        auto w = image.getWidth();
-        auto h = image.getHeight();
+    }
 
-        auto minSetting = GL_LINEAR_MIPMAP_LINEAR;
-        auto magSetting = GL_LINEAR;
+    Assimp::IOStream* RecordingIOSystem::Open(const char* file, const char* mode)
+    {
+        auto stream = Assimp::DefaultIOSystem::Open(file, mode);
+        if (stream && std::find(mPaths.begin(), mPaths.end(), file) == mPaths.end())
+        {
+            mPaths.emplace_back(file);
+        }
 
-        glBindTexture(GL_TEXTURE_2D,id);
-        glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,w,h,0,GL_BGRA,GL_UNSIGNED_BYTE,data);
-        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,minSetting);
-        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,magSetting);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        glBindTexture(GL_TEXTURE_2D,0);
-        image.clear();
+        return stream;
+    }
+
+    GLuint getPlaceholder(glc::TexType type)
+    {
+        static auto diffuse = GLuint(0);
+        static auto specular = GLuint(0);
+
+        auto& id = type == glc::TexType::DIFF ? diffuse : specular;
+        if (! id)
+        {
+            id = glc::makeTexture(::makePlaceholderImage(type));
+        }
 
         return id;
     }
+
+    GLuint getPlaceholderArray(glc::TexType type)
+    {
+        static auto diffuse = GLuint(0);
+        static auto specular = GLuint(0);
+
+        auto& id = type == glc::TexType::DIFF ? diffuse : specular;
+        if (! id)
+        {
+            auto levels = std::vector<glc::Image>{::makePlaceholderImage(type)};
+            id = glc::makeTextureArray({&levels});
+        }
+
+        return id;
+    }
+
+    glc::Image makePlaceholderImage(glc::TexType type)
+    {
+        // Mid grey for diffuse; black for specular, so no highlight.
+        auto image = glc::Image();
+        image.width = 1;
+        image.height = 1;
+        image.channels = 4;
+        image.pixels = type == glc::TexType::DIFF
+            ? std::vector<unsigned char>{128, 128, 128, 255}
+            : std::vector<unsigned char>{0, 0, 0, 255};
+        return image;
+    }
+
+    glm::mat4 makeMat(const aiMatrix4x4& m)
+    {
+        // Assimp is row-major, glm column-major.
+        auto mat = glm::mat4(1.0f);
+        mat[0] = glm::vec4(m.a1, m.b1, m.c1, m.d1);
+        mat[1] = glm::vec4(m.a2, m.b2, m.c2, m.d2);
+        mat[2] = glm::vec4(m.a3, m.b3, m.c3, m.d3);
+        mat[3] = glm::vec4(m.a4, m.b4, m.c4, m.d4);
+        return mat;
+    }
+
+    // Points attributes 0-2 at the bound array buffer, laid out as format.
+    void setVertexAttributes(glc::VexFormat format)
+    {
+        auto stride = glc::getVertexStride(format);
+
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+        glEnableVertexAttribArray(2);
+
+        switch (format)
+        {
+        case glc::VexFormat::FULL:
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride,
+                (GLvoid*)offsetof(glc::Vex, pos));
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
+                (GLvoid*)offsetof(glc::Vex, norm));
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride,
+                (GLvoid*)offsetof(glc::Vex, uv));
+            break;
+        case glc::VexFormat::PACKED:
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride,
+                (GLvoid*)offsetof(glc::PackedVex, pos));
+            glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride,
+                (GLvoid*)offsetof(glc::PackedVex, norm));
+            glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride,
+                (GLvoid*)offsetof(glc::PackedVex, uv));
+            break;
+        case glc::VexFormat::QUANTIZED:
+            glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+                (GLvoid*)offsetof(glc::QuantizedVex, pos));
+            glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride,
+                (GLvoid*)offsetof(glc::QuantizedVex, norm));
+            glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride,
+                (GLvoid*)offsetof(glc::QuantizedVex, uv));
+            break;
+        }
+    }
 }
@@ -3,16 +3,31 @@
 #ifndef GLC_MODEL_HPP
 #define GLC_MODEL_HPP
 
+#include "blocks.hpp"
+#include "buffer.hpp"
+#include "compress.hpp"
+#include "shader.hpp"
+#include "texture.hpp"
+#include "transform.hpp"
+
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <assimp/scene.h>
 
+#include <chrono>
+#include <deque>
+#include <future>
+#include <memory>
 #include <vector>
 #include <string>
 #include <unordered_map>
+#include <utility>
 
 namespace glc {
-    class Shader;
+    class RenderQueue;
+    struct MeshData;
+    struct ModelSource;
+    struct TexRef;
 
     struct Vex
     {
@@ -21,48 +36,340 @@ namespace glc {
         glm::vec2 uv;
     };
 
+    enum class VexFormat
+    {
+        // 32 bytes, glc::Vex as is.
+        FULL,
+        // 20 bytes, glc::PackedVex.
+        PACKED,
+        // 16 bytes, glc::QuantizedVex.
+        QUANTIZED
+    };
+
     enum class TexType
     {
         SPEC,
         DIFF
     };
 
+    // With a layer of zero or more, id names a GL_TEXTURE_2D_ARRAY.
     struct Tex
     {
         GLuint id;
         TexType type;
+        GLint layer;
+    };
+
+    // One node's reference to a shared mesh.
+    struct MeshInstance
+    {
+        GLuint mesh;
+        GLuint node;
+    };
+
+    // Texture arrays sit on units of their own, away from the per-mesh
+    // 2D textures, so the two sampler types never share a unit.
+    const GLint DIFFUSE_UNIT = 0;
+    const GLint SPECULAR_UNIT = 1;
+    const GLint DIFFUSE_ARRAY_UNIT = 14;
+    const GLint SPECULAR_ARRAY_UNIT = 15;
+
+    // Handles for everything Mesh::draw sets, resolved once per shader.
+    // The texture ones are optional, as not every shader samples them.
+    struct MeshUniforms
+    {
+        glc::Uniform<GLint> diffuse;
+        glc::Uniform<GLint> specular;
+        glc::Uniform<GLint> diffuseLayer;
+        glc::Uniform<GLint> specularLayer;
+        glc::Uniform<GLint> diffuseArray;
+        glc::Uniform<GLint> specularArray;
+        glc::Uniform<GLint> textureArrays;
+        glc::Uniform<glm::mat4> model;
+        glc::Uniform<glm::mat3> normal;
+        glc::Uniform<glm::vec3> vertexOffset;
+        glc::Uniform<glm::vec3> vertexScale;
+        glc::Uniform<GLint> packedNormals;
     };
 
+    // Per-instance attributes for Mesh::drawInstanced, tightly packed: the
+    // model matrix takes locations 3-6 and its normal matrix 7-9.
+    struct InstanceData
+    {
+        glm::mat4 model;
+        glm::mat3 normal;
+    };
+
+    const GLuint INSTANCE_MODEL_LOCATION = 3;
+    const GLuint INSTANCE_NORMAL_LOCATION = 7;
+    // Draw index for multi-draw shaders without gl_BaseInstanceARB.
+    const GLuint DRAW_INDEX_LOCATION = 10;
+
+    // Owns its GL buffers. After upload only what draw() needs is kept,
+    // unless the CPU-side geometry is explicitly asked for.
     class Mesh
     {
     public:
         explicit
-        Mesh(const std::vector<glc::Vex>& vertices,
+        Mesh(const glc::Vex* vertices, size_t numVertices,
              const std::vector<glc::Tex>& textures,
-             const std::vector<GLuint>& indices);
+             const GLuint* indices, size_t numIndices,
+             glc::VexFormat format = glc::VexFormat::FULL,
+             bool keepCpuCopy = false);
+        ~Mesh();
 
-        void draw(glc::Shader* shader);
+        Mesh(const Mesh&) = delete;
+        Mesh& operator=(const Mesh&) = delete;
+        Mesh(Mesh&& other) noexcept;
+        Mesh& operator=(Mesh&& other) noexcept;
+
+        // Only the first texture of each type is bound; the shaders never
+        // sample more than that.
+        void draw(glc::Shader* shader, const glc::MeshUniforms& uniforms);
+        // As draw(), count times over, reading glc::InstanceData from the
+        // buffer last given to setInstanceBuffer().
+        void drawInstanced(glc::Shader* shader, const glc::MeshUniforms& uniforms,
+                           GLsizei count);
+        // Points the per-instance attributes at buffer. The binding lives in
+        // the vertex array, so this only needs redoing if the name changes.
+        void setInstanceBuffer(GLuint buffer);
+        // The pieces of draw() for callers that bind state themselves:
+        // the first texture of the type, with a placeholder standing in
+        // while it streams or when the mesh has none (then false), and
+        // every uniform draw() sets.
+        bool findTexture(glc::TexType type, glc::Tex& tex) const;
+        void setUniforms(glc::Shader* shader, const glc::MeshUniforms& uniforms) const;
+        GLuint getVertexArray() const;
+        GLuint getVertexBuffer() const;
+        GLuint getIndexBuffer() const;
+        glm::vec3 getVertexOffset() const;
+        glm::vec3 getVertexScale() const;
+        void setTexture(size_t slot, GLuint id);
+        void setTextureLayer(size_t slot, GLuint array, GLint layer);
+        // Shifts the slots after it down by one.
+        void removeTexture(size_t slot);
+        const std::vector<glc::Tex>& getTextures() const;
+        GLsizei getNumIndices() const;
+        GLenum getIndexType() const;
+        glm::vec3 getMin() const;
+        glm::vec3 getMax() const;
+        const std::vector<glc::Vex>& getVertices() const;
+        const std::vector<GLuint>& getIndices() const;
     private:
-        std::vector<glc::Vex> mVertices;
         std::vector<glc::Tex> mTextures;
+        std::vector<glc::Vex> mVertices;
         std::vector<GLuint> mIndices;
         GLuint mVao, mVbo, mEbo;
+        GLsizei mNumIndices;
+        GLenum mIndexType;
+        glc::VexFormat mFormat;
+        glm::vec3 mOffset;
+        glm::vec3 mScale;
+        glm::vec3 mMin;
+        glm::vec3 mMax;
+
+        // Helper Methods
+        void bind(glc::Shader* shader, const glc::MeshUniforms& uniforms);
+        void release();
+    };
+
+    // Laid out as GL reads a DrawElementsIndirectCommand.
+    struct DrawCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    // Whether glMultiDrawElementsIndirect and shader storage blocks are
+    // there, natively (GL 4.3) or as extensions.
+    bool isMultiDrawSupported();
+
+    // Every mesh instance of a model copied into one vertex and one index
+    // buffer and drawn with glMultiDrawElementsIndirect, one call per pair
+    // of texture arrays and index type. Each draw's node transform,
+    // dequantization and layers go to the Draws storage block, indexed by
+    // each command's baseInstance, which counts across all of the calls
+    // (read as gl_BaseInstanceARB, or through DRAW_INDEX_LOCATION without
+    // draw parameters). Textures outside arrays are not bound, so they
+    // sample black.
+    class MeshBatch
+    {
+    public:
+        MeshBatch();
+        ~MeshBatch();
+
+        MeshBatch(const MeshBatch&) = delete;
+        MeshBatch& operator=(const MeshBatch&) = delete;
+        MeshBatch(MeshBatch&& other) noexcept;
+        MeshBatch& operator=(MeshBatch&& other) noexcept;
+
+        // Copies the meshes on the GPU; they must all be uploaded, in format,
+        // and keep their textures from here on.
+        void build(const std::vector<glc::Mesh>& meshes,
+                   const std::vector<glc::MeshInstance>& instances,
+                   glc::VexFormat format);
+        bool isBuilt() const;
+        // The nodes must be up to date.
+        void draw(glc::Shader* shader, const glc::MeshUniforms& uniforms,
+                  const glc::TransformGraph& nodes);
+        size_t getNumDraws() const;
+        size_t getNumCalls() const;
+    private:
+        // A run of commands sharing everything bound between calls.
+        struct Call
+        {
+            GLuint diffuseArray;
+            GLuint specularArray;
+            GLenum indexType;
+            size_t first;
+            GLsizei count;
+        };
+
+        GLuint mVao;
+        glc::Buffer mVertices;
+        glc::Buffer mIndices;
+        glc::Buffer mCommands;
+        glc::Buffer mDrawIndices;
+        glc::Buffer mDraws;
+        std::vector<glc::DrawBlock> mDrawData;
+        std::vector<GLuint> mDrawNodes;
+        std::vector<Call> mCalls;
+        bool mPackedNormals;
+
+        // Helper Methods
+        void release();
+    };
+
+    enum class LoadMode
+    {
+        // Everything is uploaded before the constructor returns.
+        BLOCKING,
+        // The constructor returns immediately; call update() every frame
+        // to upload whatever the workers have finished so far.
+        STREAMING
+    };
+
+    // Post-import processing steps; results are baked into the mesh cache.
+    enum ModelFlags : unsigned int
+    {
+        MODEL_DEFAULT = 0,
+        // Reorder triangles for vertex cache locality and overdraw, then
+        // vertices for fetch locality.
+        MODEL_OPTIMIZE = 1 << 0,
+        // Merge exactly equal vertices.
+        MODEL_WELD = 1 << 1,
+        // Merge vertices equal within glc::WELD_EPSILON.
+        MODEL_WELD_NEAR = 1 << 2,
+        // Upload vertices as glc::VexFormat::PACKED.
+        MODEL_PACK = 1 << 3,
+        // Upload vertices as glc::VexFormat::QUANTIZED.
+        MODEL_QUANTIZE = 1 << 4,
+        // Keep each mesh's vertices and indices in memory after upload.
+        MODEL_KEEP_CPU_COPY = 1 << 5,
+        // Pack same-sized textures into GL_TEXTURE_2D_ARRAYs once all of
+        // them are decoded, so meshes switch layers instead of binds.
+        MODEL_TEXTURE_ARRAYS = 1 << 6
     };
 
     class Model
     {
     public:
-        explicit Model(std::string path);
-        void draw(glc::Shader* shader);
+        explicit Model(std::string path,
+                       glc::LoadMode mode = glc::LoadMode::BLOCKING,
+                       unsigned int flags = glc::MODEL_DEFAULT);
+        ~Model();
+
+        Model(const Model&) = delete;
+        Model& operator=(const Model&) = delete;
+        // A moved-from model is left with no texture arrays to delete.
+        Model(Model&& other);
+
+        void update(float budget);
+        void draw(glc::Shader* shader, glm::mat4 transform = glm::mat4(1.0f));
+        // Queues the draws instead of issuing them. They refer back to the
+        // model, which must outlive the queue's next flush().
+        void submit(glc::RenderQueue& queue, glc::Shader* shader,
+                    glm::mat4 transform = glm::mat4(1.0f), unsigned int pass = 0);
+        // One draw call per mesh for all count transforms. The shader must
+        // read the per-instance attributes (phong with INSTANCED defined);
+        // the transforms are copied, so the array can go once this returns.
+        void drawInstanced(glc::Shader* shader, const glm::mat4* transforms, size_t count);
+        // The whole model through a glc::MeshBatch, built on first use. Needs
+        // isMultiDrawSupported(), a shader with MULTI_DRAW defined and
+        // MODEL_TEXTURE_ARRAYS; draws nothing until isLoaded().
+        void drawIndirect(glc::Shader* shader, glm::mat4 transform = glm::mat4(1.0f));
+        bool isLoaded() const;
+        // Node lookups are only meaningful once the source has been read,
+        // which for streaming models happens in a later update().
+        int findNode(const std::string& name) const;
+        void setNodeTransform(size_t node, glm::mat4 local);
     private:
+        // Either levels or compressed is filled in, or neither when the
+        // texture was already registered.
+        struct DecodedTex
+        {
+            std::string key;
+            std::vector<glc::Image> levels;
+            glc::CompressedImage compressed;
+        };
+
+        struct PendingTex
+        {
+            std::string path;
+            bool srgb;
+            std::future<DecodedTex> decoded;
+        };
+
+        struct PendingSlot
+        {
+            size_t mesh;
+            size_t slot;
+        };
+
         std::vector<glc::Mesh> mMeshes;
-        std::unordered_map<std::string, glc::Tex> mLoadedTextures;
+        std::vector<glc::MeshInstance> mInstances;
+        glc::TransformGraph mNodes;
+        std::unordered_map<std::string, glc::TexHandle> mLoadedTextures;
+        std::string mPath;
         std::string mBaseDirectory;
+        glc::VexFormat mFormat;
+        bool mKeepCpuCopy;
+        bool mPackTextures;
+        std::chrono::steady_clock::time_point mStartTime;
+        std::future<std::shared_ptr<glc::ModelSource>> mPendingSource;
+        std::shared_ptr<glc::ModelSource> mSource;
+        size_t mNextMesh;
+        std::deque<PendingTex> mPendingTextures;
+        std::unordered_multimap<std::string, PendingSlot> mPendingSlots;
+        std::vector<std::pair<std::string, DecodedTex>> mDecodedTextures;
+        std::vector<GLuint> mTextureArrays;
+        // One entry per shader drawn with, so queued draws keep pointing at
+        // their own handles whichever shader the model is used with next.
+        std::unordered_map<const glc::Shader*, glc::MeshUniforms> mUniforms;
+        std::vector<glc::InstanceData> mInstanceData;
+        glc::Buffer mInstanceBuffer;
+        size_t mInstancedMeshes;
+        glc::MeshBatch mBatch;
+        bool mLoaded;
 
         // Helper Methods
-        void processNode(const aiScene* scene, const aiNode* node);
-        void processMesh(const aiScene* scene, const aiMesh* mesh);
-        std::vector<glc::Tex> getTex(const aiMaterial* mat, const aiTextureType type);
+        static std::shared_ptr<glc::ModelSource> loadSource(std::string path, unsigned int flags);
+        static void postProcess(std::vector<glc::MeshData>& meshes, unsigned int flags);
+        static void processNode(const aiNode* node, int parent, glc::TransformGraph& nodes,
+                                std::vector<glc::MeshInstance>& instances);
+        static void processMesh(const aiScene* scene, const aiMesh* mesh, glc::MeshData& data);
+        static std::vector<glc::TexRef> getTex(const aiMaterial* mat, const aiTextureType type);
+        void addMesh(const glc::Vex* vertices, size_t numVertices,
+                     const GLuint* indices, size_t numIndices,
+                     const std::vector<glc::TexRef>& textures);
+        const glc::MeshUniforms& resolveUniforms(const glc::Shader* shader);
+        void queueTextures();
+        bool uploadTexture(bool wait);
+        void packTextures();
+        void finishLoading();
     };
 }
 
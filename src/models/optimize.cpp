@@ -0,0 +1,491 @@
+#include "optimize.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+namespace {
+    struct Adjacency
+    {
+        std::vector<GLuint> offsets;
+        std::vector<GLuint> triangles;
+    };
+
+    struct VexHash
+    {
+        size_t operator()(const glc::Vex& v) const;
+    };
+
+    struct VexEqual
+    {
+        bool operator()(const glc::Vex& a, const glc::Vex& b) const;
+    };
+
+    // 64-bit so that far out coordinates over a tiny epsilon still fit.
+    struct Cell
+    {
+        int64_t x;
+        int64_t y;
+        int64_t z;
+    };
+
+    struct CellHash
+    {
+        size_t operator()(const Cell& c) const;
+    };
+
+    struct CellEqual
+    {
+        bool operator()(const Cell& a, const Cell& b) const;
+    };
+
+    void weldExact(std::vector<glc::Vex>& vertices, std::vector<GLuint>& remap);
+    void weldNear(std::vector<glc::Vex>& vertices, std::vector<GLuint>& remap, float epsilon);
+    bool isNear(const glc::Vex& a, const glc::Vex& b, float epsilon);
+    int64_t toCell(float coord, float epsilon);
+
+    Adjacency makeAdjacency(const std::vector<GLuint>& indices, size_t numVertices);
+    long skipDeadEnd(const std::vector<GLuint>& live, std::vector<GLuint>& deadEnds, size_t& cursor);
+    std::vector<size_t> tipsify(std::vector<GLuint>& indices, size_t numVertices);
+    void sortClusters(const std::vector<glc::Vex>& vertices, std::vector<GLuint>& indices,
+                      const std::vector<size_t>& clusters);
+}
+
+void glc::weldVertices(std::vector<glc::Vex>& vertices, std::vector<GLuint>& indices, float epsilon)
+{
+    auto remap = std::vector<GLuint>(vertices.size());
+
+    if (epsilon > 0.0f)
+    {
+        ::weldNear(vertices, remap, epsilon);
+    }
+    else
+    {
+        ::weldExact(vertices, remap);
+    }
+
+    for (auto& i : indices)
+    {
+        i = remap[i];
+    }
+}
+
+glc::CacheStats glc::analyzeVertexCache(const std::vector<GLuint>& indices, size_t numVertices)
+{
+    // FIFO cache: a vertex only gets a new timestamp when it misses.
+    auto stamps = std::vector<size_t>(numVertices, 0);
+    auto used = std::vector<bool>(numVertices, false);
+    auto time = glc::VERTEX_CACHE_SIZE + 1;
+    auto misses = size_t(0);
+    auto unique = size_t(0);
+
+    for (auto v : indices)
+    {
+        if (! used[v])
+        {
+            used[v] = true;
+            unique += 1;
+        }
+
+        if (time - stamps[v] > glc::VERTEX_CACHE_SIZE)
+        {
+            stamps[v] = time;
+            time += 1;
+            misses += 1;
+        }
+    }
+
+    auto stats = glc::CacheStats();
+    stats.acmr = indices.empty() ? 0.0f : float(misses) / (indices.size() / 3);
+    stats.atvr = unique == 0 ? 0.0f : float(misses) / unique;
+
+    return stats;
+}
+
+void glc::optimizeVertexCache(const std::vector<glc::Vex>& vertices, std::vector<GLuint>& indices)
+{
+    auto clusters = ::tipsify(indices, vertices.size());
+    ::sortClusters(vertices, indices, clusters);
+}
+
+void glc::optimizeVertexFetch(std::vector<glc::Vex>& vertices, std::vector<GLuint>& indices)
+{
+    const auto unset = std::numeric_limits<GLuint>::max();
+    auto remap = std::vector<GLuint>(vertices.size(), unset);
+    auto reordered = std::vector<glc::Vex>();
+    reordered.reserve(vertices.size());
+
+    for (auto& v : indices)
+    {
+        if (remap[v] == unset)
+        {
+            remap[v] = reordered.size();
+            reordered.emplace_back(vertices[v]);
+        }
+
+        v = remap[v];
+    }
+
+    vertices.swap(reordered);
+}
+
+
+namespace {
+    size_t VexHash::operator()(const glc::Vex& v) const
+    {
+        const float fields[] = {
+            v.pos.x, v.pos.y, v.pos.z,
+            v.norm.x, v.norm.y, v.norm.z,
+            v.uv.x, v.uv.y
+        };
+
+        // FNV-1a over the bit patterns; -0 and +0 compare equal so they
+        // must hash equal too.
+        auto hash = uint64_t(14695981039346656037ull);
+        for (auto f : fields)
+        {
+            uint32_t bits;
+            f = f == 0.0f ? 0.0f : f;
+            std::memcpy(&bits, &f, sizeof(bits));
+            hash ^= bits;
+            hash *= 1099511628211ull;
+        }
+
+        return hash;
+    }
+
+    bool VexEqual::operator()(const glc::Vex& a, const glc::Vex& b) const
+    {
+        return a.pos == b.pos && a.norm == b.norm && a.uv == b.uv;
+    }
+
+    size_t CellHash::operator()(const Cell& c) const
+    {
+        return size_t(c.x) * 73856093 ^ size_t(c.y) * 19349663 ^ size_t(c.z) * 83492791;
+    }
+
+    bool CellEqual::operator()(const Cell& a, const Cell& b) const
+    {
+        return a.x == b.x && a.y == b.y && a.z == b.z;
+    }
+
+    void weldExact(std::vector<glc::Vex>& vertices, std::vector<GLuint>& remap)
+    {
+        auto unique = std::unordered_map<glc::Vex, GLuint, VexHash, VexEqual>();
+        auto welded = std::vector<glc::Vex>();
+        unique.reserve(vertices.size());
+
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            auto it = unique.emplace(vertices[i], GLuint(welded.size()));
+            if (it.second)
+            {
+                welded.emplace_back(vertices[i]);
+            }
+
+            remap[i] = it.first->second;
+        }
+
+        vertices.swap(welded);
+    }
+
+    void weldNear(std::vector<glc::Vex>& vertices, std::vector<GLuint>& remap, float epsilon)
+    {
+        // Bucket by position on an epsilon sized grid; any vertex within
+        // epsilon of another sits in the same or a neighbouring cell.
+        auto cells = std::unordered_map<Cell, std::vector<GLuint>, CellHash, CellEqual>();
+        auto welded = std::vector<glc::Vex>();
+
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            const auto& v = vertices[i];
+            auto cell = Cell{
+                ::toCell(v.pos.x, epsilon),
+                ::toCell(v.pos.y, epsilon),
+                ::toCell(v.pos.z, epsilon)};
+
+            auto match = std::numeric_limits<GLuint>::max();
+            for (auto dz = -1; dz <= 1 && match == std::numeric_limits<GLuint>::max(); dz++)
+            for (auto dy = -1; dy <= 1 && match == std::numeric_limits<GLuint>::max(); dy++)
+            for (auto dx = -1; dx <= 1 && match == std::numeric_limits<GLuint>::max(); dx++)
+            {
+                auto it = cells.find(Cell{cell.x + dx, cell.y + dy, cell.z + dz});
+                if (it == cells.end())
+                {
+                    continue;
+                }
+
+                for (auto candidate : it->second)
+                {
+                    if (::isNear(welded[candidate], v, epsilon))
+                    {
+                        match = candidate;
+                        break;
+                    }
+                }
+            }
+
+            if (match == std::numeric_limits<GLuint>::max())
+            {
+                match = welded.size();
+                welded.emplace_back(v);
+                cells[cell].emplace_back(match);
+            }
+
+            remap[i] = match;
+        }
+
+        vertices.swap(welded);
+    }
+
+    bool isNear(const glc::Vex& a, const glc::Vex& b, float epsilon)
+    {
+        return std::fabs(a.pos.x - b.pos.x) <= epsilon
+            && std::fabs(a.pos.y - b.pos.y) <= epsilon
+            && std::fabs(a.pos.z - b.pos.z) <= epsilon
+            && std::fabs(a.norm.x - b.norm.x) <= epsilon
+            && std::fabs(a.norm.y - b.norm.y) <= epsilon
+            && std::fabs(a.norm.z - b.norm.z) <= epsilon
+            && std::fabs(a.uv.x - b.uv.x) <= epsilon
+            && std::fabs(a.uv.y - b.uv.y) <= epsilon;
+    }
+
+    int64_t toCell(float coord, float epsilon)
+    {
+        // Divided in double and clamped well inside int64_t, so neither a
+        // huge coordinate nor an inf or NaN one turns into undefined casts;
+        // clamped positions all share the outermost cell.
+        const auto limit = double(int64_t(1) << 62);
+        auto cell = std::floor(double(coord) / epsilon);
+        if (std::isnan(cell))
+        {
+            return 0;
+        }
+
+        return int64_t(std::max(-limit, std::min(cell, limit)));
+    }
+
+    Adjacency makeAdjacency(const std::vector<GLuint>& indices, size_t numVertices)
+    {
+        auto adj = Adjacency();
+        adj.offsets.assign(numVertices + 1, 0);
+        adj.triangles.resize(indices.size());
+
+        for (auto v : indices)
+        {
+            adj.offsets[v + 1] += 1;
+        }
+
+        for (size_t v = 0; v < numVertices; v++)
+        {
+            adj.offsets[v + 1] += adj.offsets[v];
+        }
+
+        auto fill = std::vector<GLuint>(adj.offsets.begin(), adj.offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            adj.triangles[fill[indices[i]]++] = i / 3;
+        }
+
+        return adj;
+    }
+
+    long skipDeadEnd(const std::vector<GLuint>& live, std::vector<GLuint>& deadEnds, size_t& cursor)
+    {
+        while (! deadEnds.empty())
+        {
+            auto v = deadEnds.back();
+            deadEnds.pop_back();
+
+            if (live[v] > 0)
+            {
+                return v;
+            }
+        }
+
+        for (; cursor < live.size(); cursor++)
+        {
+            if (live[cursor] > 0)
+            {
+                return cursor;
+            }
+        }
+
+        return -1;
+    }
+
+    // Sander, Nehab & Barczak, "Fast Triangle Reordering for Vertex Locality
+    // and Reduced Overdraw" (2007). Returns the first triangle of every
+    // cluster, i.e. every point where the cache had to start over.
+    std::vector<size_t> tipsify(std::vector<GLuint>& indices, size_t numVertices)
+    {
+        const auto k = glc::VERTEX_CACHE_SIZE;
+        const auto numTriangles = indices.size() / 3;
+        auto adj = ::makeAdjacency(indices, numVertices);
+
+        auto live = std::vector<GLuint>(numVertices, 0);
+        for (size_t v = 0; v < numVertices; v++)
+        {
+            live[v] = adj.offsets[v + 1] - adj.offsets[v];
+        }
+
+        auto stamps = std::vector<size_t>(numVertices, 0);
+        auto emitted = std::vector<bool>(numTriangles, false);
+        auto deadEnds = std::vector<GLuint>();
+        auto candidates = std::vector<GLuint>();
+        auto output = std::vector<GLuint>();
+        auto clusters = std::vector<size_t>();
+        output.reserve(indices.size());
+
+        auto time = k + 1;
+        auto cursor = size_t(0);
+        auto fan = ::skipDeadEnd(live, deadEnds, cursor);
+
+        while (fan >= 0)
+        {
+            if (time - stamps[fan] > k)
+            {
+                clusters.emplace_back(output.size() / 3);
+            }
+
+            candidates.clear();
+
+            for (auto a = adj.offsets[fan]; a < adj.offsets[fan + 1]; a++)
+            {
+                auto t = adj.triangles[a];
+                if (emitted[t])
+                {
+                    continue;
+                }
+
+                for (size_t c = 0; c < 3; c++)
+                {
+                    auto v = indices[t * 3 + c];
+                    output.emplace_back(v);
+                    deadEnds.emplace_back(v);
+                    candidates.emplace_back(v);
+                    live[v] -= 1;
+
+                    if (time - stamps[v] > k)
+                    {
+                        stamps[v] = time;
+                        time += 1;
+                    }
+                }
+
+                emitted[t] = true;
+            }
+
+            // Prefer the candidate that stays longest in the cache while it
+            // is still being fanned around.
+            auto next = long(-1);
+            auto best = long(-1);
+            for (auto v : candidates)
+            {
+                if (live[v] == 0)
+                {
+                    continue;
+                }
+
+                auto priority = long(0);
+                if (time - stamps[v] + 2 * live[v] <= k)
+                {
+                    priority = time - stamps[v];
+                }
+
+                if (priority > best)
+                {
+                    best = priority;
+                    next = v;
+                }
+            }
+
+            fan = next >= 0 ? next : ::skipDeadEnd(live, deadEnds, cursor);
+        }
+
+        indices.swap(output);
+
+        return clusters;
+    }
+
+    // Orders clusters so the ones facing away from the mesh centre are drawn
+    // first; from any viewpoint those tend to occlude the rest.
+    void sortClusters(const std::vector<glc::Vex>& vertices, std::vector<GLuint>& indices,
+                      const std::vector<size_t>& clusters)
+    {
+        const auto numTriangles = indices.size() / 3;
+        if (clusters.size() < 2)
+        {
+            return;
+        }
+
+        auto centroids = std::vector<glm::vec3>(clusters.size(), glm::vec3(0.0f));
+        auto normals = std::vector<glm::vec3>(clusters.size(), glm::vec3(0.0f));
+        auto areas = std::vector<float>(clusters.size(), 0.0f);
+        auto meshCentroid = glm::vec3(0.0f);
+        auto meshArea = 0.0f;
+
+        for (size_t c = 0; c < clusters.size(); c++)
+        {
+            auto end = c + 1 < clusters.size() ? clusters[c + 1] : numTriangles;
+            for (auto t = clusters[c]; t < end; t++)
+            {
+                const auto& p0 = vertices[indices[t * 3 + 0]].pos;
+                const auto& p1 = vertices[indices[t * 3 + 1]].pos;
+                const auto& p2 = vertices[indices[t * 3 + 2]].pos;
+
+                auto normal = glm::cross(p1 - p0, p2 - p0);
+                auto area = glm::length(normal);
+                auto centre = (p0 + p1 + p2) / 3.0f;
+
+                normals[c] += normal;
+                centroids[c] += centre * area;
+                areas[c] += area;
+            }
+
+            meshCentroid += centroids[c];
+            meshArea += areas[c];
+        }
+
+        if (meshArea > 0.0f)
+        {
+            meshCentroid = meshCentroid / meshArea;
+        }
+
+        auto metrics = std::vector<float>(clusters.size(), 0.0f);
+        for (size_t c = 0; c < clusters.size(); c++)
+        {
+            auto length = glm::length(normals[c]);
+            if (areas[c] > 0.0f && length > 0.0f)
+            {
+                auto centre = centroids[c] / areas[c];
+                metrics[c] = glm::dot(centre - meshCentroid, normals[c] / length);
+            }
+        }
+
+        auto order = std::vector<size_t>(clusters.size());
+        for (size_t c = 0; c < order.size(); c++)
+        {
+            order[c] = c;
+        }
+
+        std::stable_sort(order.begin(), order.end(), [&metrics](size_t a, size_t b)
+        {
+            return metrics[a] > metrics[b];
+        });
+
+        auto sorted = std::vector<GLuint>();
+        sorted.reserve(indices.size());
+        for (auto c : order)
+        {
+            auto begin = clusters[c] * 3;
+            auto end = (c + 1 < clusters.size() ? clusters[c + 1] : numTriangles) * 3;
+            sorted.insert(sorted.end(), indices.begin() + begin, indices.begin() + end);
+        }
+
+        indices.swap(sorted);
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#ifndef GLC_OPTIMIZE_HPP
+#define GLC_OPTIMIZE_HPP
+
+#include "model.hpp"
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace glc {
+    // Size of the simulated post-transform FIFO cache.
+    const size_t VERTEX_CACHE_SIZE = 16;
+
+    // Largest per-component difference at which near-equal vertices are
+    // still welded together.
+    const float WELD_EPSILON = 1e-5f;
+
+    struct CacheStats
+    {
+        // Average cache miss ratio: transformed vertices per triangle.
+        float acmr;
+        // Average transform to vertex ratio: transformed vertices per
+        // unique vertex, 1.0 being optimal.
+        float atvr;
+    };
+
+    // Merges vertices sharing the same position, normal and uv and remaps
+    // the indices accordingly. With an epsilon of zero only exactly equal
+    // vertices are merged.
+    void weldVertices(std::vector<glc::Vex>& vertices, std::vector<GLuint>& indices,
+                      float epsilon = 0.0f);
+
+    glc::CacheStats analyzeVertexCache(const std::vector<GLuint>& indices, size_t numVertices);
+
+    // Reorders triangles with Tipsify for post-transform cache locality,
+    // then sorts the resulting clusters front-facing-out to cut overdraw.
+    void optimizeVertexCache(const std::vector<glc::Vex>& vertices, std::vector<GLuint>& indices);
+
+    // Renumbers vertices in first-use order for pre-transform fetch
+    // locality. Unreferenced vertices are dropped.
+    void optimizeVertexFetch(std::vector<glc::Vex>& vertices, std::vector<GLuint>& indices);
+}
+
+#endif
@@ -0,0 +1,123 @@
+#include "packing.hpp"
+
+#include <glm/gtc/packing.hpp>
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+    void packNormal(glm::vec3 normal, GLshort* out);
+    GLushort packUnorm16(float value);
+    void packUv(glm::vec2 uv, GLushort* out);
+}
+
+std::vector<unsigned char> glc::packVertices(
+    const glc::Vex* vertices, size_t numVertices, glc::VexFormat format,
+    glm::vec3& offset, glm::vec3& scale)
+{
+    offset = glm::vec3(0.0f);
+    scale = glm::vec3(1.0f);
+
+    auto stride = glc::getVertexStride(format);
+    auto packed = std::vector<unsigned char>(numVertices * stride);
+
+    switch (format)
+    {
+    case glc::VexFormat::FULL:
+        if (numVertices)
+        {
+            std::memcpy(packed.data(), vertices, packed.size());
+        }
+        break;
+
+    case glc::VexFormat::PACKED:
+        for (size_t i = 0; i < numVertices; i++)
+        {
+            auto v = glc::PackedVex();
+            v.pos = vertices[i].pos;
+            ::packNormal(vertices[i].norm, v.norm);
+            ::packUv(vertices[i].uv, v.uv);
+            std::memcpy(&packed[i * stride], &v, sizeof(v));
+        }
+        break;
+
+    case glc::VexFormat::QUANTIZED:
+        if (numVertices)
+        {
+            auto lo = vertices[0].pos;
+            auto hi = vertices[0].pos;
+            for (size_t i = 1; i < numVertices; i++)
+            {
+                lo = glm::min(lo, vertices[i].pos);
+                hi = glm::max(hi, vertices[i].pos);
+            }
+
+            offset = lo;
+            scale = hi - lo;
+        }
+
+        for (size_t i = 0; i < numVertices; i++)
+        {
+            auto v = glc::QuantizedVex();
+            for (auto c = 0; c < 3; c++)
+            {
+                auto t = scale[c] > 0.0f ? (vertices[i].pos[c] - offset[c]) / scale[c] : 0.0f;
+                v.pos[c] = ::packUnorm16(t);
+            }
+            v.pos[3] = 0;
+            ::packNormal(vertices[i].norm, v.norm);
+            ::packUv(vertices[i].uv, v.uv);
+            std::memcpy(&packed[i * stride], &v, sizeof(v));
+        }
+        break;
+    }
+
+    return packed;
+}
+
+GLsizei glc::getVertexStride(glc::VexFormat format)
+{
+    switch (format)
+    {
+    case glc::VexFormat::PACKED:
+        return sizeof(glc::PackedVex);
+    case glc::VexFormat::QUANTIZED:
+        return sizeof(glc::QuantizedVex);
+    default:
+        return sizeof(glc::Vex);
+    }
+}
+
+
+namespace {
+    void packNormal(glm::vec3 normal, GLshort* out)
+    {
+        // Octahedral encoding: project onto the octahedron, then fold the
+        // lower hemisphere over the diagonals.
+        auto sum = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+        auto x = sum > 0.0f ? normal.x / sum : 0.0f;
+        auto y = sum > 0.0f ? normal.y / sum : 0.0f;
+
+        if (normal.z < 0.0f)
+        {
+            auto fx = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            auto fy = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            x = fx;
+            y = fy;
+        }
+
+        out[0] = static_cast<GLshort>(std::round(glm::clamp(x, -1.0f, 1.0f) * 32767.0f));
+        out[1] = static_cast<GLshort>(std::round(glm::clamp(y, -1.0f, 1.0f) * 32767.0f));
+    }
+
+    GLushort packUnorm16(float value)
+    {
+        return static_cast<GLushort>(std::round(glm::clamp(value, 0.0f, 1.0f) * 65535.0f));
+    }
+
+    void packUv(glm::vec2 uv, GLushort* out)
+    {
+        out[0] = glm::packHalf1x16(uv.x);
+        out[1] = glm::packHalf1x16(uv.y);
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#ifndef GLC_PACKING_HPP
+#define GLC_PACKING_HPP
+
+#include "model.hpp"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace glc {
+    // float position, octahedral snorm16 normal, half float uv.
+    struct PackedVex
+    {
+        glm::vec3 pos;
+        GLshort norm[2];
+        GLushort uv[2];
+    };
+
+    // unorm16 position relative to the mesh bounds (w is padding),
+    // octahedral snorm16 normal, half float uv.
+    struct QuantizedVex
+    {
+        GLushort pos[4];
+        GLshort norm[2];
+        GLushort uv[2];
+    };
+
+    // Packs vertices into the given format. Positions decode in the shader
+    // as offset + scale * pos, which is the identity for unquantized formats.
+    std::vector<unsigned char> packVertices(
+        const glc::Vex* vertices, size_t numVertices, glc::VexFormat format,
+        glm::vec3& offset, glm::vec3& scale);
+
+    GLsizei getVertexStride(glc::VexFormat format);
+}
+
+#endif
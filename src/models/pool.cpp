@@ -0,0 +1,75 @@
+#include "pool.hpp"
+
+glc::ThreadPool::ThreadPool(size_t numThreads)
+: mWorkers(),
+  mJobs(),
+  mMutex(),
+  mSignal(),
+  mStopping(false)
+{
+    for (size_t i = 0; i < numThreads; i++)
+    {
+        mWorkers.emplace_back(&glc::ThreadPool::work, this);
+    }
+}
+
+glc::ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+
+    mSignal.notify_all();
+
+    for (auto& w : mWorkers)
+    {
+        w.join();
+    }
+}
+
+size_t glc::ThreadPool::getSize() const
+{
+    return mWorkers.size();
+}
+
+glc::ThreadPool& glc::ThreadPool::getDefault()
+{
+    // Leave one core for the GL thread.
+    static auto cores = std::thread::hardware_concurrency();
+    static glc::ThreadPool pool(cores > 1 ? cores - 1 : 1);
+    return pool;
+}
+
+void glc::ThreadPool::push(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mJobs.emplace(std::move(job));
+    }
+
+    mSignal.notify_one();
+}
+
+void glc::ThreadPool::work()
+{
+    while (true)
+    {
+        std::function<void()> job;
+
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mSignal.wait(lock, [this]() { return mStopping || ! mJobs.empty(); });
+
+            if (mStopping && mJobs.empty())
+            {
+                return;
+            }
+
+            job = std::move(mJobs.front());
+            mJobs.pop();
+        }
+
+        job();
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#ifndef GLC_POOL_HPP
+#define GLC_POOL_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace glc {
+    // Fixed-size pool of worker threads for CPU-only work (decoding,
+    // encoding, ...). Anything touching GL must stay on the main thread.
+    class ThreadPool
+    {
+    public:
+        explicit ThreadPool(size_t numThreads);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        template <typename F>
+        auto submit(F func) -> std::future<decltype(func())>;
+
+        size_t getSize() const;
+
+        static glc::ThreadPool& getDefault();
+    private:
+        std::vector<std::thread> mWorkers;
+        std::queue<std::function<void()>> mJobs;
+        std::mutex mMutex;
+        std::condition_variable mSignal;
+        bool mStopping;
+
+        // Helper Methods
+        void push(std::function<void()> job);
+        void work();
+    };
+
+    template <typename F>
+    auto ThreadPool::submit(F func) -> std::future<decltype(func())>
+    {
+        using Result = decltype(func());
+
+        auto task = std::make_shared<std::packaged_task<Result()>>(func);
+        auto result = task->get_future();
+        this->push([task]() { (*task)(); });
+
+        return result;
+    }
+}
+
+#endif
@@ -0,0 +1,111 @@
+#include "preprocess.hpp"
+#include "common.hpp"
+#include "error.hpp"
+
+#include <set>
+#include <sstream>
+
+namespace {
+    // Keeps include cycles and diamonds from pulling a file in twice.
+    struct IncludeState
+    {
+        std::set<std::string> included;
+        int nextSource;
+    };
+
+    void appendFile(std::string path, int source, IncludeState& state,
+                    const glc::ShaderDefines* defines, std::string& out);
+    bool parseInclude(const std::string& path, const std::string& line, std::string& name);
+    std::string getDirectory(const std::string& path);
+}
+
+std::string glc::preprocessShader(std::string path, const glc::ShaderDefines& defines)
+{
+    auto state = IncludeState();
+    state.included.insert(path);
+    state.nextSource = 1;
+
+    auto out = std::string();
+    ::appendFile(path, 0, state, &defines, out);
+    return out;
+}
+
+std::string glc::makeDefinesKey(const glc::ShaderDefines& defines)
+{
+    auto key = std::string();
+    for (const auto& d : defines)
+    {
+        key += key.empty() ? "" : ";";
+        key += d.first + "=" + d.second;
+    }
+
+    return key;
+}
+
+
+namespace {
+    void appendFile(std::string path, int source, IncludeState& state,
+                    const glc::ShaderDefines* defines, std::string& out)
+    {
+        std::istringstream stream(glc::makeString(path));
+        auto line = std::string();
+        auto number = 0;
+
+        while (std::getline(stream, line))
+        {
+            number++;
+
+            auto name = std::string();
+            if (::parseInclude(path, line, name))
+            {
+                auto includePath = ::getDirectory(path) + name;
+                if (state.included.insert(includePath).second)
+                {
+                    auto includeSource = state.nextSource++;
+                    out += "#line 1 " + std::to_string(includeSource) + "\n";
+                    ::appendFile(includePath, includeSource, state, nullptr, out);
+                }
+                out += "#line " + std::to_string(number + 1) + " " + std::to_string(source) + "\n";
+                continue;
+            }
+
+            out += line + "\n";
+
+            // Defines must follow #version, which has to come first.
+            if (defines && line.compare(0, 8, "#version") == 0)
+            {
+                for (const auto& d : *defines)
+                {
+                    out += "#define " + d.first + " " + d.second + "\n";
+                }
+                out += "#line " + std::to_string(number + 1) + " " + std::to_string(source) + "\n";
+                defines = nullptr;
+            }
+        }
+    }
+
+    bool parseInclude(const std::string& path, const std::string& line, std::string& name)
+    {
+        auto start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+        {
+            return false;
+        }
+
+        auto open = line.find('"', start + 8);
+        auto close = open == std::string::npos ? open : line.find('"', open + 1);
+        if (close == std::string::npos || line.find_first_not_of(" \t", start + 8) != open)
+        {
+            throw glc::MalformedShaderText(path, "malformed #include: " + line);
+        }
+
+        name = line.substr(open + 1, close - open - 1);
+        return true;
+    }
+
+    std::string getDirectory(const std::string& path)
+    {
+        auto slash = path.find_last_of("/");
+        return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#ifndef GLC_PREPROCESS_HPP
+#define GLC_PREPROCESS_HPP
+
+#include <map>
+#include <string>
+
+namespace glc {
+    // Name to value; sorted, so equal sets always produce the same key.
+    typedef std::map<std::string, std::string> ShaderDefines;
+
+    // Returns the source at path with every #include "file" (relative to
+    // the including file) spliced in, each file at most once, and the
+    // defines placed right after #version. #line directives keep compiler
+    // messages pointing at the original lines, with includes numbered
+    // from 1 in the order they were first reached.
+    std::string preprocessShader(std::string path, const glc::ShaderDefines& defines);
+
+    // Stable text form of the defines, "A=1;B=2".
+    std::string makeDefinesKey(const glc::ShaderDefines& defines);
+}
+
+#endif
@@ -0,0 +1,217 @@
+#include "progcache.hpp"
+#include "common.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+
+namespace {
+    // Bump whenever the on-disk layout changes.
+    const uint32_t CACHE_VERSION = 1;
+    const char CACHE_MAGIC[4] = {'G', 'L', 'C', 'P'};
+
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint32_t binaryFormat;
+        uint32_t binaryLength;
+    };
+
+    std::string getString(GLenum name);
+    std::string getShaderSource(GLuint shader);
+}
+
+glc::ProgramCache::ProgramCache(std::string path, const std::vector<std::string>& sources)
+: mPath(path + ".glcprog"),
+  mKey(0)
+{
+    // Separators keep ("ab", "c") and ("a", "bc") apart.
+    auto hash = glc::hashString(::getString(GL_VENDOR));
+    hash = glc::hashString(std::string(1, '\0') + ::getString(GL_RENDERER), hash);
+    hash = glc::hashString(std::string(1, '\0') + ::getString(GL_VERSION), hash);
+    for (const auto& s : sources)
+    {
+        hash = glc::hashString(std::string(1, '\0') + s, hash);
+    }
+
+    mKey = hash;
+}
+
+bool glc::ProgramCache::isSupported()
+{
+    if (! GLEW_VERSION_4_1 && ! GLEW_ARB_get_program_binary)
+    {
+        return false;
+    }
+
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+void glc::ProgramCache::prepare(GLuint program) const
+{
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+bool glc::ProgramCache::load(GLuint program) const
+{
+    std::ifstream file(mPath, std::ios::binary);
+    if (! file)
+    {
+        return false;
+    }
+
+    auto bytes = std::vector<char>(std::istreambuf_iterator<char>(file),
+                                   std::istreambuf_iterator<char>());
+    if (bytes.size() < sizeof(Header))
+    {
+        return false;
+    }
+
+    auto header = Header();
+    std::memcpy(&header, bytes.data(), sizeof(Header));
+
+    auto valid = std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0
+        && header.version == CACHE_VERSION
+        && header.key == mKey
+        && sizeof(Header) + uint64_t(header.binaryLength) <= bytes.size();
+    if (! valid)
+    {
+        return false;
+    }
+
+    // Drivers are free to reject binaries at any time, e.g. after an
+    // update that kept the version string.
+    glProgramBinary(program, header.binaryFormat, bytes.data() + sizeof(Header), header.binaryLength);
+
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    return success;
+}
+
+bool glc::ProgramCache::save(GLuint program) const
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+    {
+        return false;
+    }
+
+    auto binary = std::vector<char>(length);
+    auto binaryFormat = GLenum(0);
+    glGetProgramBinary(program, length, &length, &binaryFormat, binary.data());
+
+    auto header = Header();
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.key = mKey;
+    header.binaryFormat = binaryFormat;
+    header.binaryLength = length;
+
+    // Write to the side and rename so a crash never leaves a torn cache.
+    auto tmpPath = mPath + ".tmp";
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    file.write(binary.data(), length);
+    file.close();
+
+    if (! file || std::rename(tmpPath.c_str(), mPath.c_str()) != 0)
+    {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+std::string glc::ProgramCache::getPath() const
+{
+    return mPath;
+}
+
+GLuint glc::makeCachedProgram(const std::vector<GLuint>& shaders, std::string dir)
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    auto sources = std::vector<std::string>();
+    auto hash = glc::hashString("");
+    for (auto s : shaders)
+    {
+        sources.emplace_back(::getShaderSource(s));
+        hash = glc::hashString(std::string(1, '\0') + sources.back(), hash);
+    }
+
+    std::ostringstream name;
+    name << dir << "/" << std::hex << hash;
+    auto cache = glc::ProgramCache(name.str(), sources);
+
+    auto program = glCreateProgram();
+    auto useCache = glc::ProgramCache::isSupported();
+    auto warm = useCache && cache.load(program);
+    if (! warm)
+    {
+        for (auto s : shaders)
+        {
+            GLint compiled;
+            glGetShaderiv(s, GL_COMPILE_STATUS, &compiled);
+            if (! compiled)
+            {
+                glCompileShader(s);
+            }
+            glAttachShader(program, s);
+        }
+
+        if (useCache)
+        {
+            cache.prepare(program);
+        }
+        glLinkProgram(program);
+
+        GLint linked;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (useCache && linked && ! cache.save(program))
+        {
+            std::cout << "Failed to write program cache: " << cache.getPath() << "\n";
+        }
+    }
+
+    auto elapsed = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - startTime);
+    std::cout << "Built " << cache.getPath() << " (" << (warm ? "warm" : "cold") << ") in "
+              << elapsed.count() << " ms\n";
+
+    return program;
+}
+
+
+namespace {
+    std::string getString(GLenum name)
+    {
+        auto value = reinterpret_cast<const char*>(glGetString(name));
+        return value ? value : "";
+    }
+
+    std::string getShaderSource(GLuint shader)
+    {
+        GLint length = 0;
+        glGetShaderiv(shader, GL_SHADER_SOURCE_LENGTH, &length);
+        if (length <= 1)
+        {
+            return "";
+        }
+
+        // The length counts the terminator, which the string must not keep.
+        auto source = std::string(length, '\0');
+        glGetShaderSource(shader, length, nullptr, &source[0]);
+        source.resize(length - 1);
+        return source;
+    }
+}
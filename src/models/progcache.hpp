@@ -0,0 +1,41 @@
+#pragma once
+
+#ifndef GLC_PROGCACHE_HPP
+#define GLC_PROGCACHE_HPP
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace glc {
+    // On-disk cache of linked program binaries. The key covers every
+    // source text as compiled (so anything injected into them, such as
+    // defines, too) and the driver's vendor, renderer and version strings;
+    // a mismatch, or a driver refusing the binary, just means a miss.
+    class ProgramCache
+    {
+    public:
+        ProgramCache(std::string path, const std::vector<std::string>& sources);
+
+        static bool isSupported();
+
+        // Call before linking so the driver keeps the binary around.
+        void prepare(GLuint program) const;
+        bool load(GLuint program) const;
+        bool save(GLuint program) const;
+        std::string getPath() const;
+    private:
+        std::string mPath;
+        uint64_t mKey;
+    };
+
+    // Links shader objects that have their source set but need not be
+    // compiled yet: the sources are read back for the key, and shaders are
+    // only compiled when the binary kept in dir, named after them, is
+    // missing or refused. Logs whether the build was warm and its time.
+    GLuint makeCachedProgram(const std::vector<GLuint>& shaders, std::string dir);
+}
+
+#endif
@@ -0,0 +1,197 @@
+#include "queue.hpp"
+#include "model.hpp"
+#include "shader.hpp"
+#include "state.hpp"
+
+#include <algorithm>
+
+namespace {
+    const GLint SLOT_UNITS[] = {
+        glc::DIFFUSE_UNIT, glc::SPECULAR_UNIT, glc::DIFFUSE_ARRAY_UNIT, glc::SPECULAR_ARRAY_UNIT
+    };
+    const GLenum SLOT_TARGETS[] = {
+        GL_TEXTURE_2D, GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_2D_ARRAY
+    };
+
+    // Key layout, in bits from the top: 4 pass, 12 program, 16 texture
+    // set, 12 VAO, 20 depth.
+    const int DEPTH_BITS = 20;
+    const int VAO_SHIFT = 20;
+    const int TEXTURE_SHIFT = 32;
+    const int PROGRAM_SHIFT = 48;
+    const int PASS_SHIFT = 60;
+}
+
+glc::RenderQueue::RenderQueue()
+: mPackets(),
+  mKeys(),
+  mScratch(),
+  mView(1.0f),
+  mFarPlane(1.0f),
+  mStats()
+{
+}
+
+void glc::RenderQueue::begin(glm::mat4 view, float farPlane)
+{
+    // A frame skipped without flush() must not leave keys behind that
+    // index past the new packets.
+    mPackets.clear();
+    mKeys.clear();
+    mView = view;
+    mFarPlane = farPlane;
+}
+
+void glc::RenderQueue::add(unsigned int pass, glc::Shader* shader, const glc::MeshUniforms* uniforms,
+                           const glc::Mesh* mesh, glm::mat4 model, glm::mat3 normal)
+{
+    auto packet = Packet();
+    packet.shader = shader;
+    packet.uniforms = uniforms;
+    packet.mesh = mesh;
+    packet.model = model;
+    packet.normal = normal;
+    packet.program = shader->getHandle();
+    packet.vao = mesh->getVertexArray();
+
+    for (auto type : {glc::TexType::DIFF, glc::TexType::SPEC})
+    {
+        auto diffuse = type == glc::TexType::DIFF;
+        packet.textures[diffuse ? 0 : 1] = 0;
+        packet.textures[diffuse ? 2 : 3] = 0;
+
+        // A map the mesh lacks comes back as a placeholder, so it still
+        // takes its slot.
+        auto tex = glc::Tex();
+        mesh->findTexture(type, tex);
+        packet.textures[(tex.layer >= 0 ? 2 : 0) + (diffuse ? 0 : 1)] = tex.id;
+    }
+
+    mKeys.emplace_back(this->makeKey(pass, packet), static_cast<uint32_t>(mPackets.size()));
+    mPackets.emplace_back(packet);
+}
+
+void glc::RenderQueue::flush()
+{
+    mStats.packets = mPackets.size();
+    mStats.changesUnsorted = this->countChanges(false);
+    this->sortKeys();
+    mStats.changesSorted = this->countChanges(true);
+
+    auto& state = glc::StateCache::getDefault();
+    for (const auto& key : mKeys)
+    {
+        const auto& p = mPackets[key.second];
+
+        p.shader->use();
+        for (int slot = 0; slot < NUM_SLOTS; slot++)
+        {
+            // Empty slots are those of the path (2D or arrays) the mesh
+            // doesn't sample through, so they keep whatever they hold.
+            if (p.textures[slot])
+            {
+                state.bindTexture(::SLOT_UNITS[slot], ::SLOT_TARGETS[slot], p.textures[slot]);
+            }
+        }
+
+        p.mesh->setUniforms(p.shader, *p.uniforms);
+        p.shader->setUniform(p.uniforms->model, p.model);
+        p.shader->setUniform(p.uniforms->normal, p.normal);
+
+        state.bindVertexArray(p.vao);
+        glDrawElements(GL_TRIANGLES, p.mesh->getNumIndices(), p.mesh->getIndexType(), 0);
+    }
+
+    mPackets.clear();
+    mKeys.clear();
+}
+
+glc::QueueStats glc::RenderQueue::getStats() const
+{
+    return mStats;
+}
+
+uint64_t glc::RenderQueue::makeKey(unsigned int pass, const Packet& packet) const
+{
+    // Mix the whole texture set down to 16 bits.
+    auto textures = uint64_t(0);
+    for (int slot = 0; slot < NUM_SLOTS; slot++)
+    {
+        textures = (textures ^ packet.textures[slot]) * 0x9E3779B97F4A7C15ull;
+    }
+
+    // Front to back by the distance of the mesh's bounds centre.
+    auto centre = (packet.mesh->getMin() + packet.mesh->getMax()) * 0.5f;
+    auto view = mView * packet.model * glm::vec4(centre, 1.0f);
+    auto distance = std::min(std::max(-view.z / mFarPlane, 0.0f), 1.0f);
+    auto depth = static_cast<uint64_t>(distance * ((1 << DEPTH_BITS) - 1));
+
+    return (static_cast<uint64_t>(pass & 0xF) << PASS_SHIFT)
+         | (static_cast<uint64_t>(packet.program & 0xFFF) << PROGRAM_SHIFT)
+         | ((textures >> 48) << TEXTURE_SHIFT)
+         | (static_cast<uint64_t>(packet.vao & 0xFFF) << VAO_SHIFT)
+         | depth;
+}
+
+void glc::RenderQueue::sortKeys()
+{
+    // LSD radix sort, a byte per pass; stable, so equal keys keep their
+    // submission order. Bytes every key shares are skipped.
+    mScratch.resize(mKeys.size());
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        size_t counts[256] = {};
+        for (const auto& k : mKeys)
+        {
+            counts[(k.first >> shift) & 0xFF]++;
+        }
+
+        if (mKeys.empty() || counts[(mKeys.front().first >> shift) & 0xFF] == mKeys.size())
+        {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (auto& c : counts)
+        {
+            auto count = c;
+            c = offset;
+            offset += count;
+        }
+
+        for (const auto& k : mKeys)
+        {
+            mScratch[counts[(k.first >> shift) & 0xFF]++] = k;
+        }
+        mKeys.swap(mScratch);
+    }
+}
+
+size_t glc::RenderQueue::countChanges(bool sorted) const
+{
+    GLuint program = 0;
+    GLuint vao = 0;
+    GLuint bound[NUM_SLOTS] = {0, 0, 0, 0};
+    size_t changes = 0;
+
+    for (size_t i = 0; i < mPackets.size(); i++)
+    {
+        const auto& p = mPackets[sorted ? mKeys[i].second : i];
+
+        changes += p.program != program;
+        changes += p.vao != vao;
+        program = p.program;
+        vao = p.vao;
+
+        for (int slot = 0; slot < NUM_SLOTS; slot++)
+        {
+            if (p.textures[slot] && p.textures[slot] != bound[slot])
+            {
+                bound[slot] = p.textures[slot];
+                changes++;
+            }
+        }
+    }
+
+    return changes;
+}
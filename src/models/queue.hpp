@@ -0,0 +1,80 @@
+#pragma once
+
+#ifndef GLC_QUEUE_HPP
+#define GLC_QUEUE_HPP
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace glc {
+    class Mesh;
+    class Shader;
+    struct MeshUniforms;
+
+    // State changes of the last flush: as the packets were added, and as
+    // they were actually submitted after sorting. Program switches, VAO
+    // binds and texture binds each count as one.
+    struct QueueStats
+    {
+        size_t packets;
+        size_t changesUnsorted;
+        size_t changesSorted;
+    };
+
+    // Collects draws for a frame and submits them ordered by a 64 bit key:
+    // pass, program, texture set, VAO, then front-to-back depth, from the
+    // most significant bits down. Program, texture and VAO fields hold
+    // truncated GL names or hashes; a collision only costs ordering, as
+    // submission compares the real bindings.
+    class RenderQueue
+    {
+    public:
+        RenderQueue();
+
+        // Starts a frame; depth is measured along the view's -z and scaled
+        // to farPlane.
+        void begin(glm::mat4 view, float farPlane);
+        // Lower passes draw first. Everything pointed to must stay alive
+        // until flush().
+        void add(unsigned int pass, glc::Shader* shader, const glc::MeshUniforms* uniforms,
+                 const glc::Mesh* mesh, glm::mat4 model, glm::mat3 normal);
+        // Sorts and draws everything added since begin(); state changes go
+        // through glc::StateCache.
+        void flush();
+        glc::QueueStats getStats() const;
+    private:
+        // Texture slots: 2D diffuse, 2D specular, then the two arrays.
+        static const int NUM_SLOTS = 4;
+
+        struct Packet
+        {
+            glc::Shader* shader;
+            const glc::MeshUniforms* uniforms;
+            const glc::Mesh* mesh;
+            glm::mat4 model;
+            glm::mat3 normal;
+            GLuint program;
+            GLuint vao;
+            GLuint textures[NUM_SLOTS];
+        };
+
+        std::vector<Packet> mPackets;
+        std::vector<std::pair<uint64_t, uint32_t>> mKeys;
+        std::vector<std::pair<uint64_t, uint32_t>> mScratch;
+        glm::mat4 mView;
+        float mFarPlane;
+        glc::QueueStats mStats;
+
+        // Helper Methods
+        uint64_t makeKey(unsigned int pass, const Packet& packet) const;
+        void sortKeys();
+        size_t countChanges(bool sorted) const;
+    };
+}
+
+#endif
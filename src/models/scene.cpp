@@ -1,10 +1,13 @@
 #include "camera.hpp"
 #include "scene.hpp"
+#include "state.hpp"
 
 #include <GLFW/glfw3.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <iostream>
+
 
 const auto MATERIALS = std::unordered_map<std::string, glc::Material> {
     {"emerald", glc::Material{
@@ -63,6 +66,26 @@ const auto MATERIALS = std::unordered_map<std::string, glc::Material> {
     }}};
 
 
+// Seconds per frame the nanosuit may spend uploading streamed data.
+const auto STREAMING_BUDGET = 0.004f;
+
+const auto FAR_PLANE = 1000.0f;
+
+// The nanosuit is lit by the sun, the moving lamp and the flashlight, and
+// its materials all carry specular maps.
+const auto PHONG_DEFINES = glc::ShaderDefines {
+    {"HAS_DIR",          "1"},
+    {"HAS_SPOT",         "1"},
+    {"HAS_SPECULAR_MAP", "1"},
+    {"NUM_POINT_LIGHTS", "1"}
+};
+
+// The crowd behind the nanosuit: a grid of copies drawn instanced.
+const auto CROWD_SIZE = 8;
+const auto CROWD_SPACING = 10.0f;
+const auto CROWD_DISTANCE = 20.0f;
+
+
 const auto CUBES = std::vector<glc::Cube>{
     { MATERIALS.at("cyan_plastic"), glm::vec3( 0.0f, 0.0f, 0.0f)  },
     { MATERIALS.at("emerald"),      glm::vec3( 2.0f, 5.0f,-15.0f) },
@@ -80,20 +103,70 @@ const auto CUBES = std::vector<glc::Cube>{
 glc::Scene::Scene(GLFWwindow* window)
 : mWindow(window),
   mCamera(window),
-  mPhong({"res/models/phong-vt.glsl", "res/models/phong-fm.glsl"}),
+  mShaders(),
+  mPhong(&mShaders.get({"res/models/phong-vt.glsl", "res/models/phong-fm.glsl"},
+                       PHONG_DEFINES, glc::CompileMode::ASYNC)),
+  mFallback(&mShaders.get({"res/models/phong-vt.glsl", "res/models/fallback-fm.glsl"})),
+  mPhongUniforms(),
+  mPhongReady(false),
+  mCrowdPhong(nullptr),
+  mCrowdUniforms(),
+  mCrowdReady(false),
+  mCrowd(),
+  mBatchPhong(nullptr),
+  mBatchUniforms(),
+  mBatchReady(false),
+  mFrameBlock(glc::BlockBinding::FRAME, sizeof(glc::FrameBlock)),
+  mLightsBlock(glc::BlockBinding::LIGHTS, sizeof(glc::LightsBlock)),
   mLight(),
-  mNanoSuit("res/images/nano/nanosuit.obj")
+  mNanoSuit("res/images/nano/nanosuit.obj", glc::LoadMode::STREAMING,
+      glc::MODEL_WELD | glc::MODEL_OPTIMIZE | glc::MODEL_QUANTIZE |
+      glc::MODEL_TEXTURE_ARRAYS),
+  mQueue(),
+  mQueueStats()
 {
     mLight.ka = glm::vec3(0.1f);
     mLight.kd = glm::vec3(1.0f);
     mLight.ks = glm::vec3(1.0f);
     mLight.pos = glm::vec3(1.2f, 1.0f, 2.0f);
     mCamera.setPosition(glm::vec3(0.5f, 0.0f, 5.0f));
+
+    auto crowdDefines = PHONG_DEFINES;
+    crowdDefines["INSTANCED"] = "1";
+    mCrowdPhong = &mShaders.get({"res/models/phong-vt.glsl", "res/models/phong-fm.glsl"},
+                                crowdDefines, glc::CompileMode::ASYNC);
+
+    // Once loaded, the nanosuit goes out in a multi-draw per texture array
+    // pair where GL allows, with gl_BaseInstanceARB if it has draw
+    // parameters.
+    if (glc::isMultiDrawSupported())
+    {
+        auto batchDefines = PHONG_DEFINES;
+        batchDefines["MULTI_DRAW"] = "1";
+        if (GLEW_ARB_shader_draw_parameters)
+        {
+            batchDefines["HAS_DRAW_PARAMETERS"] = "1";
+        }
+        mBatchPhong = &mShaders.get({"res/models/phong-vt.glsl", "res/models/phong-fm.glsl"},
+                                    batchDefines, glc::CompileMode::ASYNC);
+    }
+
+    auto offset = (CROWD_SIZE - 1) * CROWD_SPACING / 2.0f;
+    for (auto i = 0; i < CROWD_SIZE; i++)
+    {
+        for (auto j = 0; j < CROWD_SIZE; j++)
+        {
+            auto position = glm::vec3(i * CROWD_SPACING - offset, 0.0f,
+                                      -CROWD_DISTANCE - j * CROWD_SPACING);
+            mCrowd.push_back(glm::translate(glm::mat4(1.0f), position));
+        }
+    }
 }
 
 void glc::Scene::update(float diftime)
 {
     mCamera.update(diftime);
+    mNanoSuit.update(STREAMING_BUDGET);
     mLight.pos.x = 1.0f + sinf(glfwGetTime()) * 2.0f;
     mLight.pos.y = sinf(glfwGetTime() / 2.0f) * 1.0f;
 }
@@ -106,40 +179,108 @@ void glc::Scene::draw()
 
     auto view = mCamera.generateMat();
     auto model = glm::mat4(1.0f);
-    auto normal = glm::mat3(glm::transpose(glm::inverse(model)));
-    auto projection = glm::perspective(45.0f, ratio, 0.1f, 1000.0f);
+    auto projection = glm::perspective(45.0f, ratio, 0.1f, FAR_PLANE);
+
+    auto& state = glc::StateCache::getDefault();
+    state.resetStats();
 
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 
-    mPhong.use();
-    mPhong.setUniform("SLight.position", mCamera.getPosition());
-    mPhong.setUniform("SLight.spotDir", mCamera.getDirection());
-    mPhong.setUniform("SLight.ka", glm::vec3(0.0f));
-    mPhong.setUniform("SLight.kd", glm::vec3(1.0f));
-    mPhong.setUniform("SLight.ks", glm::vec3(1.0f));
-    mPhong.setUniform("SLight.cutInAngle", glm::cos(glm::radians(12.5f)));
-    mPhong.setUniform("SLight.cutOffAngle", glm::cos(glm::radians(17.5f)));
-    mPhong.setUniform("DLight.ka", glm::vec3(0.1f));
-    mPhong.setUniform("DLight.kd", glm::vec3(0.1f));
-    mPhong.setUniform("DLight.ks", glm::vec3(0.1f));
-    mPhong.setUniform("DLight.direction", glm::vec3(-0.2f, -1.0f, -0.3f));
-    mPhong.setUniform("PLight.position", mLight.pos);
-    mPhong.setUniform("PLight.ka", mLight.ka);
-    mPhong.setUniform("PLight.kd", mLight.kd);
-    mPhong.setUniform("PLight.ks", glm::vec3(1.0f));
-    mPhong.setUniform("PLight.kc", 1.0f);
-    mPhong.setUniform("PLight.kl", 0.09f);
-    mPhong.setUniform("PLight.kq", 0.032f);
-    mPhong.setUniform("Material.a", 64.0f);
-    mPhong.setUniform("Model", model);
-    mPhong.setUniform("View", view);
-    mPhong.setUniform("Projection", projection);
-    mPhong.setUniform("Normal", normal);
-    mPhong.setUniform("CameraPosition", mCamera.getPosition());
-
-    mNanoSuit.draw(&mPhong);
-
-    glUseProgram(0);
+    // Everything shared by the programs goes out in one upload per block.
+    auto frame = glc::FrameBlock();
+    frame.view = view;
+    frame.projection = projection;
+    frame.cameraPosition = mCamera.getPosition();
+    mFrameBlock.update(&frame);
+
+    auto lights = glc::LightsBlock();
+    lights.spot.position = mCamera.getPosition();
+    lights.spot.spotDir = mCamera.getDirection();
+    lights.spot.ka = glm::vec3(0.0f);
+    lights.spot.kd = glm::vec3(1.0f);
+    lights.spot.ks = glm::vec3(1.0f);
+    lights.spot.cutInAngle = glm::cos(glm::radians(12.5f));
+    lights.spot.cutOffAngle = glm::cos(glm::radians(17.5f));
+    lights.dir.ka = glm::vec3(0.1f);
+    lights.dir.kd = glm::vec3(0.1f);
+    lights.dir.ks = glm::vec3(0.1f);
+    lights.dir.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+    lights.points[0].position = mLight.pos;
+    lights.points[0].ka = mLight.ka;
+    lights.points[0].kd = mLight.kd;
+    lights.points[0].ks = glm::vec3(1.0f);
+    lights.points[0].kc = 1.0f;
+    lights.points[0].kl = 0.09f;
+    lights.points[0].kq = 0.032f;
+    mLightsBlock.update(&lights);
+
+    // Keep drawing with the fallback until the driver has built phong.
+    if (! mPhongReady && mPhong->isReady())
+    {
+        this->resolveUniforms();
+        mPhongReady = true;
+    }
+
+    if (mBatchPhong && ! mBatchReady && mBatchPhong->isReady())
+    {
+        mBatchUniforms.materialA = mBatchPhong->getUniform<GLfloat>("Material.a");
+        mBatchReady = true;
+    }
+
+    if (! mCrowdReady && mCrowdPhong->isReady())
+    {
+        mCrowdUniforms.materialA = mCrowdPhong->getUniform<GLfloat>("Material.a");
+        mCrowdReady = true;
+    }
+
+    // Batching needs the final texture layers, so it waits for loading.
+    auto batched = mBatchReady && mNanoSuit.isLoaded();
+
+    mQueue.begin(view, FAR_PLANE);
+    if (batched)
+    {
+        mBatchPhong->use();
+        mBatchPhong->setUniform(mBatchUniforms.materialA, 64.0f);
+        mNanoSuit.drawIndirect(mBatchPhong, model);
+    }
+    else if (mPhongReady)
+    {
+        mPhong->use();
+        mPhong->setUniform(mPhongUniforms.materialA, 64.0f);
+        mNanoSuit.submit(mQueue, mPhong, model);
+    }
+    else
+    {
+        mNanoSuit.submit(mQueue, mFallback, model);
+    }
+    mQueue.flush();
+
+    // Every copy in the crowd goes out in one draw call per mesh. It is
+    // left out until its variant is built rather than falling back.
+    if (mCrowdReady)
+    {
+        mCrowdPhong->use();
+        mCrowdPhong->setUniform(mCrowdUniforms.materialA, 64.0f);
+        mNanoSuit.drawInstanced(mCrowdPhong, mCrowd.data(), mCrowd.size());
+    }
+
+    // Only report when the picture changes, e.g. as meshes stream in. The
+    // batch reports itself when built.
+    auto stats = mQueue.getStats();
+    if (! batched && (stats.packets != mQueueStats.packets ||
+                      stats.changesSorted != mQueueStats.changesSorted))
+    {
+        auto calls = state.getStats();
+        std::cout << "Queue: " << stats.packets << " draws, " << stats.changesUnsorted
+                  << " state changes unsorted, " << stats.changesSorted << " sorted; "
+                  << calls.issued << " binds issued, " << calls.elided << " elided\n";
+        mQueueStats = stats;
+    }
+}
+
+void glc::Scene::resolveUniforms()
+{
+    mPhongUniforms.materialA = mPhong->getUniform<GLfloat>("Material.a");
 }
@@ -3,13 +3,17 @@
 #ifndef GLC_SCENE_HPP
 #define GLC_SCENE_HPP
 
+#include "blocks.hpp"
 #include "camera.hpp"
 #include "shader.hpp"
 #include "model.hpp"
+#include "queue.hpp"
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
+#include <vector>
+
 struct GLFWwindow;
 
 namespace glc {
@@ -36,6 +40,13 @@ namespace glc {
         glm::vec3 position;
     };
 
+    // Handles into the phong shader, resolved once at startup. Camera and
+    // lights come from the shared uniform blocks instead.
+    struct PhongUniforms
+    {
+        glc::Uniform<GLfloat> materialA;
+    };
+
     class Scene
     {
     public:
@@ -46,9 +57,28 @@ namespace glc {
     private:
         GLFWwindow* mWindow;
         glc::Camera mCamera;
-        glc::Shader mPhong;
+        glc::ShaderLibrary mShaders;
+        glc::Shader* mPhong;
+        glc::Shader* mFallback;
+        glc::PhongUniforms mPhongUniforms;
+        bool mPhongReady;
+        glc::Shader* mCrowdPhong;
+        glc::PhongUniforms mCrowdUniforms;
+        bool mCrowdReady;
+        std::vector<glm::mat4> mCrowd;
+        // Null when GL has no multi-draw indirect.
+        glc::Shader* mBatchPhong;
+        glc::PhongUniforms mBatchUniforms;
+        bool mBatchReady;
+        glc::UniformBuffer mFrameBlock;
+        glc::UniformBuffer mLightsBlock;
         glc::Light  mLight;
         glc::Model  mNanoSuit;
+        glc::RenderQueue mQueue;
+        glc::QueueStats mQueueStats;
+
+        // Helper Methods
+        void resolveUniforms();
     };
 
 }
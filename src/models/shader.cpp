@@ -1,9 +1,19 @@
 #include "shader.hpp"
+#include "blocks.hpp"
 #include "common.hpp"
 #include "error.hpp"
+#include "progcache.hpp"
+#include "state.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
 namespace {
     const auto shaderType = std::unordered_map<std::string, GLenum>
     {
@@ -11,118 +21,404 @@ namespace {
         {"fm", GL_FRAGMENT_SHADER }
     };
 
-    GLuint makeShader(std::string path);
+    GLuint makeShader(std::string path, const std::string& text);
     GLenum makeShaderType(std::string path);
-    GLvoid makeProgram(GLuint handle);
+    GLvoid checkShader(GLuint handle, std::string path);
+    GLvoid checkProgram(GLuint handle);
+    GLvoid enableParallelCompile();
+
+    bool isType(GLenum type, const glm::vec3*);
+    bool isType(GLenum type, const glm::mat4*);
+    bool isType(GLenum type, const glm::mat3*);
+    bool isType(GLenum type, const GLfloat*);
+    bool isType(GLenum type, const GLint*);
+    size_t getValueSize(GLenum type);
 }
 
-glc::Shader::Shader(std::vector<std::string> paths)
+glc::Shader::Shader(std::vector<std::string> paths, glc::CompileMode mode,
+                    const glc::ShaderDefines& defines)
 : mHandle(glCreateProgram()),
-  mUniformCache(),
-  mPaths(paths)
+  mUniforms(),
+  mShadow(),
+  mStats(),
+  mPaths(paths),
+  mDefinesKey(glc::makeDefinesKey(defines)),
+  mShaders(),
+  mTexts(),
+  mCachePath(paths.front()),
+  mStartTime(std::chrono::steady_clock::now()),
+  mWarm(false),
+  mReady(false)
 {
-    auto srcHandles = std::vector<GLuint>();
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        mTexts.emplace_back(glc::preprocessShader(paths[i], defines));
+        if (i)
+        {
+            mCachePath += "+" + paths[i].substr(paths[i].find_last_of("/") + 1);
+        }
+    }
 
-    for (auto p : paths)
+    // Variants share their sources, so keep their cached binaries apart.
+    if (! defines.empty())
     {
-        auto srcHandle = ::makeShader(p);
-        glAttachShader(mHandle, srcHandle);
-        srcHandles.emplace_back(srcHandle);
+        std::ostringstream suffix;
+        suffix << "+" << std::hex << glc::hashString(mDefinesKey);
+        mCachePath += suffix.str();
     }
 
-    ::makeProgram(mHandle);
+    auto cache = glc::ProgramCache(mCachePath, mTexts);
+    auto useCache = glc::ProgramCache::isSupported();
+    mWarm = useCache && cache.load(mHandle);
 
-    for (auto sh : srcHandles)
+    if (! mWarm)
     {
-        glDeleteShader(sh);
+        ::enableParallelCompile();
+
+        // No status queries here: each would stall until that stage is done.
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            auto srcHandle = ::makeShader(paths[i], mTexts[i]);
+            glAttachShader(mHandle, srcHandle);
+            mShaders.emplace_back(srcHandle);
+        }
+
+        if (useCache)
+        {
+            cache.prepare(mHandle);
+        }
+
+        glLinkProgram(mHandle);
+    }
+
+    if (mode == glc::CompileMode::BLOCKING)
+    {
+        this->finish();
     }
 }
 
 glc::Shader::~Shader()
 {
+    for (auto sh : mShaders)
+    {
+        glDeleteShader(sh);
+    }
     glDeleteProgram(mHandle);
 }
 
+bool glc::Shader::isReady()
+{
+    if (mReady)
+    {
+        return true;
+    }
+
+    if (GLEW_KHR_parallel_shader_compile)
+    {
+        GLint done = GL_FALSE;
+        glGetProgramiv(mHandle, GL_COMPLETION_STATUS_KHR, &done);
+        if (! done)
+        {
+            return false;
+        }
+    }
+
+    this->finish();
+    return true;
+}
+
+void glc::Shader::wait()
+{
+    if (! mReady)
+    {
+        this->finish();
+    }
+}
+
 void glc::Shader::use()
 {
-    glUseProgram(mHandle);
+    this->wait();
+    glc::StateCache::getDefault().useProgram(mHandle);
 }
 
-void glc::Shader::setUniform(std::string name, glm::vec3 value)
+GLuint glc::Shader::getHandle() const
 {
-    const auto handle = this->getUniform(name);
-    glUniform3f(handle, value.x, value.y, value.z);
+    return mHandle;
 }
 
-void glc::Shader::setUniform(std::string name, glm::mat4 value)
+template <typename T>
+glc::Uniform<T> glc::Shader::getUniform(const std::string& name) const
 {
-    const auto handle = this->getUniform(name);
-    glUniformMatrix4fv(handle, 1, GL_FALSE, glm::value_ptr(value));
+    auto uniform = this->findUniform<T>(name);
+    if (uniform.location == -1)
+    {
+        throw glc::MalformedUniform(mPaths, name);
+    }
+
+    return uniform;
 }
 
-void glc::Shader::setUniform(std::string name, glm::mat3 value)
+template <typename T>
+glc::Uniform<T> glc::Shader::findUniform(const std::string& name) const
 {
-    const auto handle = this->getUniform(name);
-    glUniformMatrix3fv(handle, 1, GL_FALSE, glm::value_ptr(value));
+    auto uniform = glc::Uniform<T>();
+    auto info = this->lookup(name);
+    if (info && ::isType(info->type, static_cast<const T*>(nullptr)))
+    {
+        uniform.location = info->location;
+        uniform.shadow = info->shadow;
+    }
+
+    return uniform;
 }
 
-void glc::Shader::setUniform(std::string name, GLfloat value)
+template glc::Uniform<glm::vec3> glc::Shader::getUniform(const std::string&) const;
+template glc::Uniform<glm::mat4> glc::Shader::getUniform(const std::string&) const;
+template glc::Uniform<glm::mat3> glc::Shader::getUniform(const std::string&) const;
+template glc::Uniform<GLfloat> glc::Shader::getUniform(const std::string&) const;
+template glc::Uniform<GLint> glc::Shader::getUniform(const std::string&) const;
+template glc::Uniform<glm::vec3> glc::Shader::findUniform(const std::string&) const;
+template glc::Uniform<glm::mat4> glc::Shader::findUniform(const std::string&) const;
+template glc::Uniform<glm::mat3> glc::Shader::findUniform(const std::string&) const;
+template glc::Uniform<GLfloat> glc::Shader::findUniform(const std::string&) const;
+template glc::Uniform<GLint> glc::Shader::findUniform(const std::string&) const;
+
+void glc::Shader::setUniform(glc::Uniform<glm::vec3> uniform, glm::vec3 value)
 {
-    const auto handle = this->getUniform(name);
-    glUniform1f(handle, value);
+    if (this->update(uniform.shadow, &value, sizeof(value)))
+    {
+        glUniform3f(uniform.location, value.x, value.y, value.z);
+    }
 }
 
-void glc::Shader::setUniform(std::string name, GLint value)
+void glc::Shader::setUniform(glc::Uniform<glm::mat4> uniform, glm::mat4 value)
 {
-    const auto handle = this->getUniform(name);
-    glUniform1i(handle, value);
+    if (this->update(uniform.shadow, &value, sizeof(value)))
+    {
+        glUniformMatrix4fv(uniform.location, 1, GL_FALSE, glm::value_ptr(value));
+    }
 }
 
-GLuint glc::Shader::getUniform(std::string name)
+void glc::Shader::setUniform(glc::Uniform<glm::mat3> uniform, glm::mat3 value)
 {
-    if (mUniformCache.count(name)) {
-        return mUniformCache[name];
+    if (this->update(uniform.shadow, &value, sizeof(value)))
+    {
+        glUniformMatrix3fv(uniform.location, 1, GL_FALSE, glm::value_ptr(value));
     }
+}
 
-    auto uniformHandle = glGetUniformLocation(mHandle, name.c_str());
+void glc::Shader::setUniform(glc::Uniform<GLfloat> uniform, GLfloat value)
+{
+    if (this->update(uniform.shadow, &value, sizeof(value)))
+    {
+        glUniform1f(uniform.location, value);
+    }
+}
 
-    if (uniformHandle == -1) {
-        throw glc::MalformedUniform(mPaths, name);
+void glc::Shader::setUniform(glc::Uniform<GLint> uniform, GLint value)
+{
+    if (this->update(uniform.shadow, &value, sizeof(value)))
+    {
+        glUniform1i(uniform.location, value);
     }
+}
 
-    mUniformCache.emplace(name, uniformHandle);
+glc::UniformStats glc::Shader::getUniformStats() const
+{
+    return mStats;
+}
 
-    return uniformHandle;
+void glc::Shader::resetUniformStats()
+{
+    mStats = glc::UniformStats();
 }
 
+void glc::Shader::setUniform(const std::string& name, glm::vec3 value)
+{
+    this->setUniform(this->getUniform<glm::vec3>(name), value);
+}
+
+void glc::Shader::setUniform(const std::string& name, glm::mat4 value)
+{
+    this->setUniform(this->getUniform<glm::mat4>(name), value);
+}
+
+void glc::Shader::setUniform(const std::string& name, glm::mat3 value)
+{
+    this->setUniform(this->getUniform<glm::mat3>(name), value);
+}
+
+void glc::Shader::setUniform(const std::string& name, GLfloat value)
+{
+    this->setUniform(this->getUniform<GLfloat>(name), value);
+}
+
+void glc::Shader::setUniform(const std::string& name, GLint value)
+{
+    this->setUniform(this->getUniform<GLint>(name), value);
+}
+
+void glc::Shader::finish()
+{
+    if (! mWarm)
+    {
+        for (size_t i = 0; i < mShaders.size(); i++)
+        {
+            ::checkShader(mShaders[i], mPaths[i]);
+        }
+        ::checkProgram(mHandle);
+
+        for (auto sh : mShaders)
+        {
+            glDetachShader(mHandle, sh);
+            glDeleteShader(sh);
+        }
+        mShaders.clear();
+
+        auto cache = glc::ProgramCache(mCachePath, mTexts);
+        if (glc::ProgramCache::isSupported() && ! cache.save(mHandle))
+        {
+            std::cout << "Failed to write program cache: " << cache.getPath() << "\n";
+        }
+    }
+    mTexts.clear();
+
+    glc::bindUniformBlocks(mHandle);
+    this->reflect();
+    mReady = true;
+
+    auto elapsed = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - mStartTime);
+    std::cout << "Built " << glc::makeString(mPaths, ", ")
+              << (mDefinesKey.empty() ? "" : " [" + mDefinesKey + "]")
+              << " (" << (mWarm ? "warm" : "cold") << ") in " << elapsed.count() << " ms\n";
+}
+
+void glc::Shader::reflect()
+{
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(mHandle, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(mHandle, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    auto name = std::vector<GLchar>(maxLength + 1);
+    for (GLint i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(mHandle, i, name.size(), &length, &size, &type, name.data());
+
+        // Arrays are reported as "name[0]"; both spellings resolve.
+        auto info = UniformInfo();
+        info.name = std::string(name.data(), length);
+        info.type = type;
+        info.location = glGetUniformLocation(mHandle, info.name.c_str());
+        if (info.location == -1)
+        {
+            // Block members have no location of their own.
+            continue;
+        }
+
+        // Only element 0 of an array can be set, so it alone is shadowed.
+        auto bytes = ::getValueSize(type);
+        info.shadow = bytes ? static_cast<GLint>(mShadow.size()) : -1;
+        mShadow.resize(mShadow.size() + (bytes ? bytes + 1 : 0), 0);
+
+        auto bracket = info.name.find("[0]");
+        if (bracket != std::string::npos && bracket + 3 == info.name.size())
+        {
+            auto base = info;
+            base.name = info.name.substr(0, bracket);
+            mUniforms.emplace_back(base);
+        }
+        mUniforms.emplace_back(info);
+    }
+
+    std::sort(mUniforms.begin(), mUniforms.end(),
+              [](const UniformInfo& a, const UniformInfo& b) { return a.name < b.name; });
+}
+
+bool glc::Shader::update(GLint shadow, const void* value, size_t size)
+{
+    if (shadow < 0)
+    {
+        return false;
+    }
+
+    // A linked program starts out all zeros, but a value is only trusted
+    // once it has been set through here.
+    auto entry = &mShadow[shadow];
+    if (entry[0] && std::memcmp(entry + 1, value, size) == 0)
+    {
+        mStats.skipped++;
+        return false;
+    }
+
+    entry[0] = 1;
+    std::memcpy(entry + 1, value, size);
+    mStats.issued++;
+    return true;
+}
+
+const glc::Shader::UniformInfo* glc::Shader::lookup(const std::string& name) const
+{
+    auto it = std::lower_bound(mUniforms.begin(), mUniforms.end(), name,
+                               [](const UniformInfo& u, const std::string& n) { return u.name < n; });
+    return it != mUniforms.end() && it->name == name ? &*it : nullptr;
+}
+
+glc::ShaderLibrary::ShaderLibrary()
+: mVariants()
+{
+}
+
+glc::Shader& glc::ShaderLibrary::get(const std::vector<std::string>& paths,
+                                     const glc::ShaderDefines& defines,
+                                     glc::CompileMode mode)
+{
+    auto key = glc::makeString(paths, ",") + "|" + glc::makeDefinesKey(defines);
+    auto& variant = mVariants[key];
+    if (! variant)
+    {
+        variant.reset(new glc::Shader(paths, mode, defines));
+    }
+
+    return *variant;
+}
+
+size_t glc::ShaderLibrary::getSize() const
+{
+    return mVariants.size();
+}
 
 namespace {
-    GLuint makeShader(std::string path)
+    GLuint makeShader(std::string path, const std::string& text)
     {
-        // Compile the shader.
-        auto srcText = glc::makeString(path);
+        // Compile the shader; glc::Shader checks the result once it's done.
         auto srcHandle = glCreateShader(::makeShaderType(path));
-        auto srcRawText = srcText.c_str();
+        auto srcRawText = text.c_str();
         glShaderSource(srcHandle, 1, &srcRawText, nullptr);
         glCompileShader(srcHandle);
 
+        return srcHandle;
+    }
+
+    GLvoid checkShader(GLuint handle, std::string path)
+    {
         // Check if shader content is not malformed.
         GLint success;
-        glGetShaderiv(srcHandle, GL_COMPILE_STATUS, &success);
+        glGetShaderiv(handle, GL_COMPILE_STATUS, &success);
         if (! success)
         {
             GLchar errMsg[512];
-            glGetShaderInfoLog(srcHandle, sizeof(errMsg), nullptr, errMsg);
+            glGetShaderInfoLog(handle, sizeof(errMsg), nullptr, errMsg);
             throw glc::MalformedShaderText(path, errMsg);
         }
-
-        return srcHandle;
     }
 
-    GLvoid makeProgram(GLuint handle)
+    GLvoid checkProgram(GLuint handle)
     {
-        glLinkProgram(handle);
-
         // Check if shader program has linked successfully.
         GLint success;
         glGetProgramiv(handle, GL_LINK_STATUS, &success);
@@ -134,6 +430,17 @@ namespace {
         }
     }
 
+    GLvoid enableParallelCompile()
+    {
+        // Let the driver pick how many threads it compiles on.
+        static auto enabled = false;
+        if (! enabled && GLEW_KHR_parallel_shader_compile)
+        {
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        }
+        enabled = true;
+    }
+
     GLenum makeShaderType(std::string path)
     {
         for (const auto& t : shaderType)
@@ -149,4 +456,68 @@ namespace {
 
         throw glc::MalformedShaderName(path);
     }
+
+    bool isType(GLenum type, const glm::vec3*)
+    {
+        return type == GL_FLOAT_VEC3;
+    }
+
+    bool isType(GLenum type, const glm::mat4*)
+    {
+        return type == GL_FLOAT_MAT4;
+    }
+
+    bool isType(GLenum type, const glm::mat3*)
+    {
+        return type == GL_FLOAT_MAT3;
+    }
+
+    bool isType(GLenum type, const GLfloat*)
+    {
+        return type == GL_FLOAT;
+    }
+
+    bool isType(GLenum type, const GLint*)
+    {
+        // Samplers and booleans are set through glUniform1i as well.
+        switch (type)
+        {
+        case GL_INT:
+        case GL_BOOL:
+        case GL_SAMPLER_2D:
+        case GL_SAMPLER_2D_ARRAY:
+        case GL_SAMPLER_3D:
+        case GL_SAMPLER_CUBE:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    size_t getValueSize(GLenum type)
+    {
+        // Matches the types the glc::Uniform setters accept.
+        if (::isType(type, static_cast<const glm::vec3*>(nullptr)))
+        {
+            return sizeof(glm::vec3);
+        }
+        if (::isType(type, static_cast<const glm::mat4*>(nullptr)))
+        {
+            return sizeof(glm::mat4);
+        }
+        if (::isType(type, static_cast<const glm::mat3*>(nullptr)))
+        {
+            return sizeof(glm::mat3);
+        }
+        if (::isType(type, static_cast<const GLfloat*>(nullptr)))
+        {
+            return sizeof(GLfloat);
+        }
+        if (::isType(type, static_cast<const GLint*>(nullptr)))
+        {
+            return sizeof(GLint);
+        }
+
+        return 0;
+    }
 }
@@ -3,33 +3,139 @@
 #ifndef GLC_SHADER_HPP
 #define GLC_SHADER_HPP
 
+#include "preprocess.hpp"
+
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 
+#include <chrono>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 namespace glc {
+    // Typed handle to a uniform of one particular glc::Shader. Resolve it
+    // once, then set it every frame without any name lookups. A location
+    // of -1 is a valid handle that setting silently ignores.
+    template <typename T>
+    struct Uniform
+    {
+        GLint location = -1;
+        // Byte offset of the value's shadow copy inside the shader.
+        GLint shadow = -1;
+    };
+
+    // Uniform updates since the last reset: issued ones reached GL, skipped
+    // ones matched the value the program already held.
+    struct UniformStats
+    {
+        size_t issued;
+        size_t skipped;
+    };
+
+    enum class CompileMode
+    {
+        // The program is linked and checked before the constructor returns.
+        BLOCKING,
+        // Compiling and linking are only submitted; poll isReady() until it
+        // holds. With KHR_parallel_shader_compile, the driver builds every
+        // submitted program on its own threads in the meantime.
+        ASYNC
+    };
+
     class Shader
     {
     public:
-         Shader(std::vector<std::string> paths);
+        // Sources go through glc::preprocessShader() with the defines, so
+        // each distinct set of them is a separate variant of the program.
+         Shader(std::vector<std::string> paths,
+                glc::CompileMode mode = glc::CompileMode::BLOCKING,
+                const glc::ShaderDefines& defines = glc::ShaderDefines());
         ~Shader();
 
+        // Never blocks while the driver still reports the program busy;
+        // without the extension, the first call finishes it on the spot.
+        // Throws the same errors as a blocking build once it completes.
+        bool isReady();
+        // Finishes the build, blocking until the driver is done with it.
+        void wait();
+        // Waits first if the program is not ready yet.
         void use();
-        void setUniform(std::string name, glm::vec3 value);
-        void setUniform(std::string name, glm::mat4 value);
-        void setUniform(std::string name, glm::mat3 value);
-        void setUniform(std::string name, GLfloat value);
-        void setUniform(std::string name, GLint value);
+        GLuint getHandle() const;
+
+        // Only meaningful once the shader is ready.
+        // Throws glc::MalformedUniform if the program has no active uniform
+        // of that name and type.
+        template <typename T>
+        glc::Uniform<T> getUniform(const std::string& name) const;
+        // Like getUniform(), but yields a -1 handle instead of throwing.
+        template <typename T>
+        glc::Uniform<T> findUniform(const std::string& name) const;
+
+        void setUniform(glc::Uniform<glm::vec3> uniform, glm::vec3 value);
+        void setUniform(glc::Uniform<glm::mat4> uniform, glm::mat4 value);
+        void setUniform(glc::Uniform<glm::mat3> uniform, glm::mat3 value);
+        void setUniform(glc::Uniform<GLfloat> uniform, GLfloat value);
+        void setUniform(glc::Uniform<GLint> uniform, GLint value);
+
+        glc::UniformStats getUniformStats() const;
+        void resetUniformStats();
+
+        // One-off conveniences; these look the name up on every call.
+        void setUniform(const std::string& name, glm::vec3 value);
+        void setUniform(const std::string& name, glm::mat4 value);
+        void setUniform(const std::string& name, glm::mat3 value);
+        void setUniform(const std::string& name, GLfloat value);
+        void setUniform(const std::string& name, GLint value);
     private:
+        // Active uniforms as reflected right after linking, sorted by name.
+        struct UniformInfo
+        {
+            std::string name;
+            GLenum type;
+            GLint location;
+            GLint shadow;
+        };
+
         const GLuint mHandle;
-        std::unordered_map<std::string, GLuint> mUniformCache;
+        std::vector<UniformInfo> mUniforms;
+        // Each entry is a flag byte, set once a value is known, followed by
+        // the last value sent to GL.
+        std::vector<unsigned char> mShadow;
+        glc::UniformStats mStats;
         std::vector<std::string> mPaths;
+        std::string mDefinesKey;
+        // Build state, only used until the program is ready. No shaders
+        // are attached when the program came from the binary cache.
+        std::vector<GLuint> mShaders;
+        std::vector<std::string> mTexts;
+        std::string mCachePath;
+        std::chrono::steady_clock::time_point mStartTime;
+        bool mWarm;
+        bool mReady;
 
         // Helper Methods
-        GLuint getUniform(std::string name);
+        void finish();
+        void reflect();
+        bool update(GLint shadow, const void* value, size_t size);
+        const UniformInfo* lookup(const std::string& name) const;
+    };
+
+    // Builds shader variants on first request and hands the same one back
+    // for every later request with equal paths and defines.
+    class ShaderLibrary
+    {
+    public:
+        ShaderLibrary();
+
+        // The mode only matters for the request that builds the variant.
+        glc::Shader& get(const std::vector<std::string>& paths,
+                         const glc::ShaderDefines& defines = glc::ShaderDefines(),
+                         glc::CompileMode mode = glc::CompileMode::BLOCKING);
+        size_t getSize() const;
+    private:
+        std::unordered_map<std::string, std::unique_ptr<glc::Shader>> mVariants;
     };
 }
 
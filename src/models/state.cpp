@@ -0,0 +1,214 @@
+#include "state.hpp"
+
+namespace {
+    const GLuint NUM_UNITS = 16;
+    const GLenum TEXTURE_TARGETS[] = {GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP};
+    const size_t NUM_TEXTURE_TARGETS = sizeof(TEXTURE_TARGETS) / sizeof(GLenum);
+    const GLenum BUFFER_TARGETS[] = {
+        GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_DRAW_INDIRECT_BUFFER,
+        GL_SHADER_STORAGE_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER
+    };
+    const size_t NUM_BUFFER_TARGETS = sizeof(BUFFER_TARGETS) / sizeof(GLenum);
+    // Indexed bindings tracked per target; higher indices go straight
+    // through.
+    const GLuint NUM_BASES = 16;
+
+    template <size_t N>
+    int findTarget(const GLenum (&targets)[N], GLenum target);
+}
+
+// Bound by reference in the conditionals below, so it needs storage.
+const GLuint glc::StateCache::UNKNOWN;
+
+glc::StateCache& glc::StateCache::getDefault()
+{
+    static glc::StateCache cache;
+    return cache;
+}
+
+void glc::StateCache::useProgram(GLuint program)
+{
+    if (this->update(mProgram, program))
+    {
+        glUseProgram(program);
+    }
+}
+
+void glc::StateCache::bindVertexArray(GLuint vao)
+{
+    if (this->update(mVertexArray, vao))
+    {
+        glBindVertexArray(vao);
+    }
+}
+
+void glc::StateCache::activeTexture(GLuint unit)
+{
+    if (this->update(mActiveUnit, unit))
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+}
+
+void glc::StateCache::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+    auto index = ::findTarget(::TEXTURE_TARGETS, target);
+    if (index < 0 || unit >= ::NUM_UNITS)
+    {
+        this->activeTexture(unit);
+        glBindTexture(target, texture);
+        mStats.issued++;
+        return;
+    }
+
+    auto& current = mTextures[unit * ::NUM_TEXTURE_TARGETS + index];
+    if (this->update(current, texture))
+    {
+        this->activeTexture(unit);
+        glBindTexture(target, texture);
+    }
+}
+
+void glc::StateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+    auto index = ::findTarget(::BUFFER_TARGETS, target);
+    if (index < 0)
+    {
+        glBindBuffer(target, buffer);
+        mStats.issued++;
+        return;
+    }
+
+    if (this->update(mBuffers[index], buffer))
+    {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void glc::StateCache::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    auto t = ::findTarget(::BUFFER_TARGETS, target);
+    if (t < 0 || index >= ::NUM_BASES)
+    {
+        glBindBufferBase(target, index, buffer);
+        mStats.issued++;
+        if (t >= 0)
+        {
+            mBuffers[t] = buffer;
+        }
+        return;
+    }
+
+    if (this->update(mBufferBases[t][index], buffer))
+    {
+        glBindBufferBase(target, index, buffer);
+        mBuffers[t] = buffer;
+    }
+}
+
+void glc::StateCache::deleteTextures(GLsizei n, const GLuint* textures)
+{
+    // GL unbinds deleted textures from every unit.
+    for (GLsizei i = 0; i < n; i++)
+    {
+        for (auto& t : mTextures)
+        {
+            t = t == textures[i] ? 0 : t;
+        }
+    }
+    glDeleteTextures(n, textures);
+}
+
+void glc::StateCache::deleteBuffers(GLsizei n, const GLuint* buffers)
+{
+    // Whether GL also resets indexed bindings has varied between spec
+    // versions, so those just become unknown.
+    for (GLsizei i = 0; i < n; i++)
+    {
+        for (auto& b : mBuffers)
+        {
+            b = b == buffers[i] ? 0 : b;
+        }
+        for (auto& bases : mBufferBases)
+        {
+            for (auto& b : bases)
+            {
+                b = b == buffers[i] ? UNKNOWN : b;
+            }
+        }
+    }
+    glDeleteBuffers(n, buffers);
+}
+
+void glc::StateCache::deleteVertexArrays(GLsizei n, const GLuint* vaos)
+{
+    for (GLsizei i = 0; i < n; i++)
+    {
+        mVertexArray = mVertexArray == vaos[i] ? 0 : mVertexArray;
+    }
+    glDeleteVertexArrays(n, vaos);
+}
+
+void glc::StateCache::invalidate()
+{
+    mProgram = UNKNOWN;
+    mVertexArray = UNKNOWN;
+    mActiveUnit = UNKNOWN;
+    mTextures.assign(mTextures.size(), UNKNOWN);
+    mBuffers.assign(mBuffers.size(), UNKNOWN);
+    for (auto& bases : mBufferBases)
+    {
+        bases.assign(bases.size(), UNKNOWN);
+    }
+}
+
+glc::StateStats glc::StateCache::getStats() const
+{
+    return mStats;
+}
+
+void glc::StateCache::resetStats()
+{
+    mStats = glc::StateStats();
+}
+
+glc::StateCache::StateCache()
+: mProgram(0),
+  mVertexArray(0),
+  mActiveUnit(0),
+  mTextures(::NUM_UNITS * ::NUM_TEXTURE_TARGETS, 0),
+  mBuffers(::NUM_BUFFER_TARGETS, 0),
+  mBufferBases(::NUM_BUFFER_TARGETS, std::vector<GLuint>(::NUM_BASES, 0)),
+  mStats()
+{
+}
+
+bool glc::StateCache::update(GLuint& current, GLuint value)
+{
+    if (current == value)
+    {
+        mStats.elided++;
+        return false;
+    }
+
+    current = value;
+    mStats.issued++;
+    return true;
+}
+
+
+namespace {
+    template <size_t N>
+    int findTarget(const GLenum (&targets)[N], GLenum target)
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            if (targets[i] == target)
+            {
+                return static_cast<int>(i);
+            }
+        }
+
+        return -1;
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#ifndef GLC_STATE_HPP
+#define GLC_STATE_HPP
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace glc {
+    // Texture creation binds on a unit of its own, so uploads never
+    // disturb what the draws left bound.
+    const GLuint UPLOAD_UNIT = 13;
+
+    // Calls that reached GL and calls dropped as redundant, since the last
+    // reset.
+    struct StateStats
+    {
+        size_t issued;
+        size_t elided;
+    };
+
+    // Shadow of the GL binding state. All glc code binds through it, so
+    // nothing needs unbinding after use; anything bypassing it must call
+    // invalidate() afterwards. Deleting objects through it keeps names
+    // GL recycles from being mistaken for still bound. Only for use on the
+    // GL thread.
+    class StateCache
+    {
+    public:
+        StateCache(const StateCache&) = delete;
+        StateCache& operator=(const StateCache&) = delete;
+
+        static glc::StateCache& getDefault();
+
+        void useProgram(GLuint program);
+        void bindVertexArray(GLuint vao);
+        void activeTexture(GLuint unit);
+        // Switches the active unit only when the bind is issued.
+        void bindTexture(GLuint unit, GLenum target, GLuint texture);
+        // The element array binding belongs to the bound VAO, so binds to
+        // GL_ELEMENT_ARRAY_BUFFER, like unknown targets, always go through.
+        void bindBuffer(GLenum target, GLuint buffer);
+        // Also sets the generic binding, as GL does.
+        void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+
+        void deleteTextures(GLsizei n, const GLuint* textures);
+        void deleteBuffers(GLsizei n, const GLuint* buffers);
+        void deleteVertexArrays(GLsizei n, const GLuint* vaos);
+
+        // Forgets everything, so the next call of each kind is issued.
+        void invalidate();
+        glc::StateStats getStats() const;
+        void resetStats();
+    private:
+        StateCache();
+
+        // A binding whose current value is unknown.
+        static const GLuint UNKNOWN = ~0u;
+
+        GLuint mProgram;
+        GLuint mVertexArray;
+        GLuint mActiveUnit;
+        // Per unit, one entry for each of the cached texture targets.
+        std::vector<GLuint> mTextures;
+        std::vector<GLuint> mBuffers;
+        // Per cached target, the indexed bindings.
+        std::vector<std::vector<GLuint>> mBufferBases;
+        glc::StateStats mStats;
+
+        // Helper Methods
+        bool update(GLuint& current, GLuint value);
+    };
+}
+
+#endif
@@ -0,0 +1,463 @@
+#include "texture.hpp"
+#include "common.hpp"
+#include "compress.hpp"
+#include "error.hpp"
+#include "mipmap.hpp"
+#include "pool.hpp"
+#include "state.hpp"
+
+#include <FreeImagePlus.h>
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace {
+    GLsizei countChannels(const fipImage& image, const unsigned char* pixels, size_t size);
+    std::vector<unsigned char> packChannels(const glc::Image& image);
+    GLenum getBlockFormat(const glc::CompressedImage& image);
+    GLsizei getBlockChannels(glc::BlockFormat format);
+    void setSwizzle(GLenum target, GLsizei channels);
+    void bindForUpload(GLenum target, GLuint id);
+}
+
+glc::Image glc::decodeImage(std::string path)
+{
+    fipImage image;
+    image.load(path.c_str());
+    image.convertTo32Bits();
+
+    auto result = glc::Image();
+    result.width = image.getWidth();
+    result.height = image.getHeight();
+
+    auto size = size_t(result.width) * result.height * 4;
+    result.pixels.resize(size);
+    result.channels = 4;
+    if (size)
+    {
+        std::memcpy(result.pixels.data(), image.accessPixels(), size);
+        result.channels = ::countChannels(image, result.pixels.data(), size);
+    }
+
+    image.clear();
+
+    return result;
+}
+
+GLuint glc::makeTexture(const glc::Image& image)
+{
+    return glc::makeTexture(glc::makeMipChain(image));
+}
+
+GLuint glc::loadTexture(std::string path, bool srgb)
+{
+    auto levels = glc::makeMipChain(glc::decodeImage(path), srgb);
+    auto size = glc::getTextureSize(levels);
+    std::cout << "Texture " << path << ": " << size.uploaded / 1024 << " KiB, "
+              << (size.rgba - size.uploaded) / 1024 << " KiB saved against RGBA8\n";
+
+    return glc::makeTexture(levels);
+}
+
+GLuint glc::makeTexture(const std::vector<glc::Image>& levels)
+{
+    GLuint id;
+    glGenTextures(1, &id);
+
+    auto skip = glc::getSkippedLevels(levels.size());
+    auto count = GLint(levels.size() - skip);
+    auto minSetting = count > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR;
+    auto magSetting = GL_LINEAR;
+
+    // Upload only the channels in use; the swizzle puts them back where
+    // shaders expect them.
+    auto channels = levels[0].channels;
+    const GLenum internalFormats[] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+    const GLenum formats[] = {GL_RED, GL_RG, GL_BGR, GL_BGRA};
+    auto internalFormat = internalFormats[channels - 1];
+    auto format = formats[channels - 1];
+
+    ::bindForUpload(GL_TEXTURE_2D, id);
+    glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+    for (GLint i = 0; i < count; i++)
+    {
+        const auto& l = levels[skip + i];
+        auto packed = ::packChannels(l);
+        auto data = packed.data();
+        glTexImage2D(GL_TEXTURE_2D,i,internalFormat,l.width,l.height,0,format,GL_UNSIGNED_BYTE,data);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT,4);
+    ::setSwizzle(GL_TEXTURE_2D, channels);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAX_LEVEL,count - 1);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,minSetting);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,magSetting);
+
+    return id;
+}
+
+GLuint glc::makeTexture(const glc::CompressedImage& image)
+{
+    GLuint id;
+    glGenTextures(1, &id);
+
+    auto internalFormat = ::getBlockFormat(image);
+
+    auto skip = glc::getSkippedLevels(image.levels.size());
+    auto count = GLint(image.levels.size() - skip);
+    auto minSetting = count > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR;
+    auto magSetting = GL_LINEAR;
+
+    ::bindForUpload(GL_TEXTURE_2D, id);
+    for (GLint i = 0; i < count; i++)
+    {
+        const auto& l = image.levels[skip + i];
+        auto data = image.data.data() + l.offset;
+        glCompressedTexImage2D(GL_TEXTURE_2D,i,internalFormat,l.width,l.height,0,l.size,data);
+    }
+    ::setSwizzle(GL_TEXTURE_2D, ::getBlockChannels(image.format));
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAX_LEVEL,count - 1);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,minSetting);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,magSetting);
+
+    return id;
+}
+
+bool glc::isBlockCompressionSupported()
+{
+    // RGTC is core since 3.0; S3TC is still an extension, if a universal one.
+    return GLEW_EXT_texture_compression_s3tc;
+}
+
+GLuint glc::makeTextureArray(const std::vector<const std::vector<glc::Image>*>& layers)
+{
+    GLuint id;
+    glGenTextures(1, &id);
+
+    const auto& first = *layers.front();
+    auto skip = glc::getSkippedLevels(first.size());
+    auto count = GLint(first.size() - skip);
+    auto depth = GLsizei(layers.size());
+    auto minSetting = count > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR;
+    auto magSetting = GL_LINEAR;
+
+    auto channels = first[0].channels;
+    const GLenum internalFormats[] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+    const GLenum formats[] = {GL_RED, GL_RG, GL_BGR, GL_BGRA};
+    auto internalFormat = internalFormats[channels - 1];
+    auto format = formats[channels - 1];
+
+    ::bindForUpload(GL_TEXTURE_2D_ARRAY, id);
+    glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+    for (GLint i = 0; i < count; i++)
+    {
+        auto w = first[skip + i].width;
+        auto h = first[skip + i].height;
+        glTexImage3D(GL_TEXTURE_2D_ARRAY,i,internalFormat,w,h,depth,0,format,GL_UNSIGNED_BYTE,nullptr);
+
+        for (GLsizei layer = 0; layer < depth; layer++)
+        {
+            auto packed = ::packChannels((*layers[layer])[skip + i]);
+            auto data = packed.data();
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY,i,0,0,layer,w,h,1,format,GL_UNSIGNED_BYTE,data);
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT,4);
+    ::setSwizzle(GL_TEXTURE_2D_ARRAY, channels);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY,GL_TEXTURE_MAX_LEVEL,count - 1);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY,GL_TEXTURE_MIN_FILTER,minSetting);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY,GL_TEXTURE_MAG_FILTER,magSetting);
+
+    return id;
+}
+
+GLuint glc::makeTextureArray(const std::vector<const glc::CompressedImage*>& layers)
+{
+    GLuint id;
+    glGenTextures(1, &id);
+
+    const auto& first = *layers.front();
+    auto internalFormat = ::getBlockFormat(first);
+    auto skip = glc::getSkippedLevels(first.levels.size());
+    auto count = GLint(first.levels.size() - skip);
+    auto depth = GLsizei(layers.size());
+    auto minSetting = count > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR;
+    auto magSetting = GL_LINEAR;
+
+    // Layers are laid out back to back per level, as GL expects them.
+    ::bindForUpload(GL_TEXTURE_2D_ARRAY, id);
+    for (GLint i = 0; i < count; i++)
+    {
+        const auto& l = first.levels[skip + i];
+        auto data = std::vector<unsigned char>(l.size * depth);
+        for (GLsizei layer = 0; layer < depth; layer++)
+        {
+            const auto& image = *layers[layer];
+            auto source = image.data.data() + image.levels[skip + i].offset;
+            std::memcpy(data.data() + l.size * layer, source, l.size);
+        }
+
+        auto size = GLsizei(data.size());
+        glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY,i,internalFormat,l.width,l.height,depth,0,size,data.data());
+    }
+    ::setSwizzle(GL_TEXTURE_2D_ARRAY, ::getBlockChannels(first.format));
+    glTexParameteri(GL_TEXTURE_2D_ARRAY,GL_TEXTURE_MAX_LEVEL,count - 1);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY,GL_TEXTURE_MIN_FILTER,minSetting);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY,GL_TEXTURE_MAG_FILTER,magSetting);
+
+    return id;
+}
+
+glc::TexSize glc::getTextureSize(const std::vector<glc::Image>& levels)
+{
+    auto size = glc::TexSize{0, 0};
+    for (auto i = glc::getSkippedLevels(levels.size()); i < levels.size(); i++)
+    {
+        auto texels = size_t(levels[i].width) * levels[i].height;
+        size.uploaded += texels * levels[i].channels;
+        size.rgba += texels * 4;
+    }
+
+    return size;
+}
+
+glc::TexSize glc::getTextureSize(const glc::CompressedImage& image)
+{
+    auto size = glc::TexSize{0, 0};
+    for (auto i = glc::getSkippedLevels(image.levels.size()); i < image.levels.size(); i++)
+    {
+        size.uploaded += image.levels[i].size;
+        size.rgba += size_t(image.levels[i].width) * image.levels[i].height * 4;
+    }
+
+    return size;
+}
+
+glc::TextureRegistry::TextureRegistry()
+: mTextures(),
+  mMutex()
+{
+
+}
+
+glc::TextureRegistry& glc::TextureRegistry::getDefault()
+{
+    static glc::TextureRegistry registry;
+    return registry;
+}
+
+std::string glc::TextureRegistry::makeKey(std::string path, bool srgb)
+{
+    char resolved[PATH_MAX];
+    auto canonical = realpath(path.c_str(), resolved) ? std::string(resolved) : path;
+
+    // Unreadable files still get a stable key; they decode to an empty
+    // image just as they did before the registry existed.
+    auto hash = uint64_t(0);
+    try
+    {
+        hash = glc::hashFile(canonical);
+    }
+    catch (const glc::MalformedFilePath&)
+    {
+
+    }
+
+    std::ostringstream key;
+    key << canonical << "#" << std::hex << hash << (srgb ? "" : "#linear");
+    return key.str();
+}
+
+bool glc::TextureRegistry::contains(const std::string& key) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto it = mTextures.find(key);
+    return it != mTextures.end() && ! it->second.expired();
+}
+
+glc::TexHandle glc::TextureRegistry::find(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto it = mTextures.find(key);
+    return it == mTextures.end() ? glc::TexHandle() : it->second.lock();
+}
+
+glc::TexHandle glc::TextureRegistry::add(const std::string& key, GLuint id)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto it = mTextures.find(key);
+    if (it != mTextures.end())
+    {
+        if (auto existing = it->second.lock())
+        {
+            glc::StateCache::getDefault().deleteTextures(1, &id);
+            return existing;
+        }
+    }
+
+    auto handle = glc::TexHandle(new GLuint(id), [this, key](const GLuint* p) {
+        this->release(key, p);
+    });
+    mTextures[key] = handle;
+
+    return handle;
+}
+
+glc::TexHandle glc::TextureRegistry::load(std::string path, bool srgb)
+{
+    auto key = makeKey(path, srgb);
+    auto handle = this->find(key);
+    if (handle)
+    {
+        return handle;
+    }
+
+    if (glc::isBlockCompressionSupported())
+    {
+        auto compressed = glc::loadCompressedImage(path, &glc::ThreadPool::getDefault(), srgb);
+        if (! compressed.levels.empty())
+        {
+            return this->add(key, glc::makeTexture(compressed));
+        }
+    }
+
+    handle = this->add(key, glc::loadTexture(path, srgb));
+
+    return handle;
+}
+
+size_t glc::TextureRegistry::getSize() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mTextures.size();
+}
+
+glc::TexHandle glc::loadTextureUnmanaged(std::string path, bool srgb)
+{
+    glc::StateCache::getDefault().invalidate();
+    return glc::TextureRegistry::getDefault().load(path, srgb);
+}
+
+void glc::TextureRegistry::release(const std::string& key, const GLuint* id)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        // The key may already have been re-added with a live texture.
+        auto it = mTextures.find(key);
+        if (it != mTextures.end() && it->second.expired())
+        {
+            mTextures.erase(it);
+        }
+    }
+
+    glc::StateCache::getDefault().deleteTextures(1, id);
+    delete id;
+}
+
+
+namespace {
+    GLsizei countChannels(const fipImage& image, const unsigned char* pixels, size_t size)
+    {
+        // Greyscale sources need no scan. Anything else is checked texel by
+        // texel, since grey maps are often saved as RGB or RGBA.
+        if (image.getColorType() == FIC_MINISBLACK && image.getBitsPerPixel() <= 16)
+        {
+            return 1;
+        }
+
+        auto grey = true;
+        auto opaque = true;
+        for (size_t i = 0; i < size && (grey || opaque); i += 4)
+        {
+            grey = grey && pixels[i] == pixels[i + 1] && pixels[i] == pixels[i + 2];
+            opaque = opaque && pixels[i + 3] == 255;
+        }
+
+        if (grey)
+        {
+            return opaque ? 1 : 2;
+        }
+
+        return opaque ? 3 : 4;
+    }
+
+    std::vector<unsigned char> packChannels(const glc::Image& image)
+    {
+        // BGRA in; R for grey, RA for grey plus alpha, BGR for colour.
+        static const size_t sources[4][4] = {{2}, {2, 3}, {0, 1, 2}, {0, 1, 2, 3}};
+
+        auto channels = size_t(image.channels);
+        const auto* source = sources[channels - 1];
+        auto texels = size_t(image.width) * image.height;
+        auto packed = std::vector<unsigned char>(texels * channels);
+        for (size_t i = 0; i < texels; i++)
+        {
+            for (size_t c = 0; c < channels; c++)
+            {
+                packed[i * channels + c] = image.pixels[i * 4 + source[c]];
+            }
+        }
+
+        return packed;
+    }
+
+    GLenum getBlockFormat(const glc::CompressedImage& image)
+    {
+        switch (image.format)
+        {
+        case glc::BlockFormat::BC1:
+            return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case glc::BlockFormat::BC3:
+            return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case glc::BlockFormat::BC4:
+            return GL_COMPRESSED_RED_RGTC1;
+        case glc::BlockFormat::BC5:
+            return GL_COMPRESSED_RG_RGTC2;
+        }
+
+        // Not reached; every format is handled above.
+        return 0;
+    }
+
+    GLsizei getBlockChannels(glc::BlockFormat format)
+    {
+        // Channels in the sense of glc::Image, for the swizzle.
+        switch (format)
+        {
+        case glc::BlockFormat::BC4:
+            return 1;
+        case glc::BlockFormat::BC5:
+            return 2;
+        default:
+            return 4;
+        }
+    }
+
+    void setSwizzle(GLenum target, GLsizei channels)
+    {
+        const GLint grey[] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+        const GLint greyAlpha[] = {GL_RED, GL_RED, GL_RED, GL_GREEN};
+        if (channels == 1)
+        {
+            glTexParameteriv(target,GL_TEXTURE_SWIZZLE_RGBA,grey);
+        }
+        else if (channels == 2)
+        {
+            glTexParameteriv(target,GL_TEXTURE_SWIZZLE_RGBA,greyAlpha);
+        }
+    }
+
+    void bindForUpload(GLenum target, GLuint id)
+    {
+        // The calls that follow act on the active unit's binding.
+        auto& state = glc::StateCache::getDefault();
+        state.activeTexture(glc::UPLOAD_UNIT);
+        state.bindTexture(glc::UPLOAD_UNIT, target, id);
+    }
+}
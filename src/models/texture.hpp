@@ -0,0 +1,105 @@
+#pragma once
+
+#ifndef GLC_TEXTURE_HPP
+#define GLC_TEXTURE_HPP
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace glc {
+    struct CompressedImage;
+
+    // CPU-side decoded image, ready to be uploaded on the GL thread.
+    // Pixels are always BGRA8; channels says how many of them the source
+    // actually uses (1 grey, 2 grey plus alpha, 3 opaque colour, 4 colour
+    // plus alpha), which decides the format it is uploaded in.
+    struct Image
+    {
+        std::vector<unsigned char> pixels;
+        GLsizei width;
+        GLsizei height;
+        GLsizei channels;
+    };
+
+    // Bytes a texture takes on the GPU as uploaded, and what it would have
+    // taken as a full RGBA8 chain.
+    struct TexSize
+    {
+        size_t uploaded;
+        size_t rgba;
+    };
+
+    // Safe to call from any thread.
+    glc::Image decodeImage(std::string path);
+
+    // Must be called on the thread owning the GL context. Levels are
+    // uploaded as given, largest first, minus what the texture tier drops;
+    // a single image gets its mip chain built on the calling thread.
+    GLuint makeTexture(const glc::Image& image);
+    GLuint makeTexture(const std::vector<glc::Image>& levels);
+    GLuint makeTexture(const glc::CompressedImage& image);
+    bool isBlockCompressionSupported();
+    // decodeImage() and makeTexture() in one go on the GL thread, logging
+    // the size uploaded against RGBA8. For loaders without workers; srgb is
+    // false for maps holding data rather than colour, such as specular.
+    GLuint loadTexture(std::string path, bool srgb = true);
+
+    // GL_TEXTURE_2D_ARRAY with one layer per input, in order. All layers
+    // must share size, channels or block format, and level count.
+    GLuint makeTextureArray(const std::vector<const std::vector<glc::Image>*>& layers);
+    GLuint makeTextureArray(const std::vector<const glc::CompressedImage*>& layers);
+
+    // What makeTexture() uploads for the same input under the current tier.
+    glc::TexSize getTextureSize(const std::vector<glc::Image>& levels);
+    glc::TexSize getTextureSize(const glc::CompressedImage& image);
+
+    // Shared reference to a texture owned by glc::TextureRegistry.
+    using TexHandle = std::shared_ptr<const GLuint>;
+
+    // Process-wide registry of uploaded textures, keyed by canonical path
+    // plus content hash, so every user of the same image shares a single
+    // upload. A texture is deleted as soon as its last handle is dropped.
+    // Only contains() may be called off the GL thread: find() hands out an
+    // owning handle, and dropping the last one deletes the texture.
+    class TextureRegistry
+    {
+    public:
+        TextureRegistry(const TextureRegistry&) = delete;
+        TextureRegistry& operator=(const TextureRegistry&) = delete;
+
+        static glc::TextureRegistry& getDefault();
+        // Reads the whole file, so best done off the GL thread. Colour and
+        // data (srgb false) versions of one image are kept apart.
+        static std::string makeKey(std::string path, bool srgb = true);
+
+        // Whether key is still uploaded, without taking a handle to it.
+        bool contains(const std::string& key) const;
+        glc::TexHandle find(const std::string& key);
+        // Takes ownership of id, unless key is already registered in which
+        // case id is deleted and the existing texture returned.
+        glc::TexHandle add(const std::string& key, GLuint id);
+        // Blocking find-or-decode-and-upload, block compressed if possible.
+        glc::TexHandle load(std::string path, bool srgb = true);
+        size_t getSize() const;
+    private:
+        std::unordered_map<std::string, std::weak_ptr<const GLuint>> mTextures;
+        mutable std::mutex mMutex;
+
+        TextureRegistry();
+
+        // Helper Methods
+        void release(const std::string& key, const GLuint* id);
+    };
+
+    // TextureRegistry::load() for callers that bind textures with raw GL
+    // calls: uploads bind through glc::StateCache, so it is invalidated first.
+    glc::TexHandle loadTextureUnmanaged(std::string path, bool srgb = true);
+}
+
+#endif
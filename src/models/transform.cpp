@@ -0,0 +1,99 @@
+#include "transform.hpp"
+
+#include <algorithm>
+
+const int glc::TransformGraph::NO_PARENT;
+
+glc::TransformGraph::TransformGraph()
+: mParents(),
+  mLocals(),
+  mWorlds(),
+  mNormals(),
+  mDirty(),
+  mNames(),
+  mFirstDirty(0)
+{
+
+}
+
+size_t glc::TransformGraph::addNode(int parent, glm::mat4 local, std::string name)
+{
+    auto node = mParents.size();
+    mParents.emplace_back(parent >= 0 && parent < int(node) ? parent : NO_PARENT);
+    mLocals.emplace_back(local);
+    mWorlds.emplace_back(1.0f);
+    mNormals.emplace_back(1.0f);
+    mDirty.emplace_back(1);
+    mNames.emplace_back(std::move(name));
+    mFirstDirty = std::min(mFirstDirty, node);
+    return node;
+}
+
+void glc::TransformGraph::setLocal(size_t node, glm::mat4 local)
+{
+    mLocals[node] = local;
+    mDirty[node] = 1;
+    mFirstDirty = std::min(mFirstDirty, node);
+}
+
+void glc::TransformGraph::update()
+{
+    // Parents precede their children, so a dirty flag is pushed down the
+    // whole subtree within the same pass. Nothing before the first dirty
+    // node can change.
+    for (size_t i = mFirstDirty; i < mParents.size(); i++)
+    {
+        auto parent = mParents[i];
+        if (parent != NO_PARENT && mDirty[parent])
+        {
+            mDirty[i] = 1;
+        }
+
+        if (! mDirty[i])
+        {
+            continue;
+        }
+
+        mWorlds[i] = parent == NO_PARENT ? mLocals[i] : mWorlds[parent] * mLocals[i];
+        mNormals[i] = glm::mat3(glm::transpose(glm::inverse(mWorlds[i])));
+    }
+
+    std::fill(mDirty.begin() + std::min(mFirstDirty, mDirty.size()), mDirty.end(), 0);
+    mFirstDirty = mParents.size();
+}
+
+int glc::TransformGraph::findNode(const std::string& name) const
+{
+    auto it = std::find(mNames.begin(), mNames.end(), name);
+    return it == mNames.end() ? NO_PARENT : int(it - mNames.begin());
+}
+
+size_t glc::TransformGraph::getSize() const
+{
+    return mParents.size();
+}
+
+int glc::TransformGraph::getParent(size_t node) const
+{
+    return mParents[node];
+}
+
+const std::string& glc::TransformGraph::getName(size_t node) const
+{
+    return mNames[node];
+}
+
+const glm::mat4& glc::TransformGraph::getLocal(size_t node) const
+{
+    return mLocals[node];
+}
+
+const glm::mat4& glc::TransformGraph::getWorld(size_t node) const
+{
+    return mWorlds[node];
+}
+
+const glm::mat3& glc::TransformGraph::getNormal(size_t node) const
+{
+    return mNormals[node];
+}
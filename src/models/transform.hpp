@@ -0,0 +1,47 @@
+#pragma once
+
+#ifndef GLC_TRANSFORM_HPP
+#define GLC_TRANSFORM_HPP
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace glc {
+    // Flattened node hierarchy. Nodes are stored parent-before-child in
+    // parallel arrays, so world transforms can be refreshed in a single
+    // linear pass over contiguous matrices, touching only dirty subtrees.
+    class TransformGraph
+    {
+    public:
+        static const int NO_PARENT = -1;
+
+        TransformGraph();
+
+        // The parent, if any, must already have been added; any other
+        // value, negative or not, makes the node a root.
+        size_t addNode(int parent, glm::mat4 local, std::string name);
+        void setLocal(size_t node, glm::mat4 local);
+        void update();
+        // First node with the given name, or NO_PARENT if there is none.
+        int findNode(const std::string& name) const;
+        size_t getSize() const;
+        int getParent(size_t node) const;
+        const std::string& getName(size_t node) const;
+        const glm::mat4& getLocal(size_t node) const;
+        const glm::mat4& getWorld(size_t node) const;
+        const glm::mat3& getNormal(size_t node) const;
+    private:
+        std::vector<int> mParents;
+        std::vector<glm::mat4> mLocals;
+        std::vector<glm::mat4> mWorlds;
+        std::vector<glm::mat3> mNormals;
+        std::vector<unsigned char> mDirty;
+        std::vector<std::string> mNames;
+        size_t mFirstDirty;
+    };
+}
+
+#endif